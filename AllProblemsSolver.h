@@ -3,6 +3,16 @@
 
 #include "DhakaRouting.h"
 #include "DhakaGraph.h"
+#include "SearchWorkspace.h"
+#include "Instrumentation.h"
+#include "CostModels.h"
+#include "ContractionHierarchy.h"
+#include "TimeDependentRouter.h"
+#include "ParetoRouter.h"
+#include "RouteCache.h"
+#include "LiveTraffic.h"
+#include "RaptorRouter.h"
+#include "Isochrone.h"
 #include <sstream>
 
 
@@ -13,251 +23,809 @@ struct RouteResult {
     std::vector<double> costs;
     std::vector<std::string> startNames;
     std::vector<std::string> endNames;
+    // Per-segment clock times (minutes since midnight); empty unless the
+    // route came from a time-dependent search
+    std::vector<double> departTimes;
+    std::vector<double> arriveTimes;
     double totalValue; 
     
     RouteResult() : totalValue(0.0) {}
+    
+    bool isTimed() const { return !departTimes.empty(); }
 };
 
-struct DijkstraNode {
-    Location location;
+// One segment of a CompactRoute. from and to index the route's nodes;
+// QUERY_POINT stands for the query's source (as from) or destination (as
+// to), which only the walks on and off the network use. Clock times are
+// zero unless the route is timed.
+struct RouteSegment {
+    uint32_t from;
+    uint32_t to;
+    TransportMode mode;
+    double distance;
     double cost;
-    
-    DijkstraNode(const Location& loc, double c) : location(loc), cost(c) {}
-    
-    bool operator>(const DijkstraNode& other) const {
-        return cost > other.cost;
+    double departTime;
+    double arriveTime;
+};
+
+// A route as the node IDs it passes plus its segment boundaries: two
+// buffers that clear() keeps for reuse, against RouteResult's eight vectors
+// and per-segment name strings. Locations and station names (from the
+// graph's interned table) are looked up only when the route is written out.
+struct CompactRoute {
+    static const uint32_t QUERY_POINT = 0xFFFFFFFFu;
+
+    Location source;
+    Location destination;
+    std::vector<NodeId> nodes;
+    std::vector<RouteSegment> segments;
+    double totalValue;
+    double departure;  // query departure of a timed route, before any wait
+    bool timed;
+
+    CompactRoute() : totalValue(0.0), departure(0.0), timed(false) {}
+
+    void clear() {
+        nodes.clear();
+        segments.clear();
+        totalValue = 0.0;
+        departure = 0.0;
+        timed = false;
+    }
+
+    bool found() const { return !segments.empty(); }
+    bool isTimed() const { return timed && !segments.empty(); }
+
+    void addSegment(uint32_t from, uint32_t to, TransportMode mode, double distance,
+                    double departTime, double arriveTime) {
+        RouteSegment segment;
+        segment.from = from;
+        segment.to = to;
+        segment.mode = mode;
+        segment.distance = distance;
+        segment.cost = 0.0;
+        segment.departTime = departTime;
+        segment.arriveTime = arriveTime;
+        segments.push_back(segment);
+    }
+
+    Location segmentStart(const DhakaGraph& graph, size_t i) const {
+        uint32_t from = segments[i].from;
+        return from == QUERY_POINT ? source : graph.getLocation(nodes[from]);
+    }
+
+    Location segmentEnd(const DhakaGraph& graph, size_t i) const {
+        uint32_t to = segments[i].to;
+        return to == QUERY_POINT ? destination : graph.getLocation(nodes[to]);
+    }
+
+    // Station name IDs at a segment's ends; the walks on and off have none
+    uint32_t startNameId(const DhakaGraph& graph, size_t i) const {
+        if (segments[i].from == QUERY_POINT || segments[i].to == QUERY_POINT) return DhakaGraph::NO_STATION_NAME;
+        return graph.getStationNameId(nodes[segments[i].from]);
+    }
+
+    uint32_t endNameId(const DhakaGraph& graph, size_t i) const {
+        if (segments[i].from == QUERY_POINT || segments[i].to == QUERY_POINT) return DhakaGraph::NO_STATION_NAME;
+        return graph.getStationNameId(nodes[segments[i].to]);
+    }
+
+    double totalDistance() const {
+        double distance = 0.0;
+        for (size_t i = 0; i < segments.size(); i++) distance += segments[i].distance;
+        return distance;
+    }
+
+    // The same route with locations and station names spelled out
+    RouteResult toResult(const DhakaGraph& graph) const {
+        RouteResult result;
+        result.totalValue = totalValue;
+        for (size_t i = 0; i < segments.size(); i++) {
+            result.segments.push_back(std::make_pair(segmentStart(graph, i), segmentEnd(graph, i)));
+            result.modes.push_back(segments[i].mode);
+            result.distances.push_back(segments[i].distance);
+            result.costs.push_back(segments[i].cost);
+            result.startNames.push_back(graph.getStationNameById(startNameId(graph, i)));
+            result.endNames.push_back(graph.getStationNameById(endNameId(graph, i)));
+            if (timed) {
+                result.departTimes.push_back(segments[i].departTime);
+                result.arriveTimes.push_back(segments[i].arriveTime);
+            }
+        }
+        return result;
     }
 };
 
+// Default clock time for the time-dependent problems when none is given
+const double DEFAULT_DEPARTURE_TIME = 8 * 60.0;
+
+enum class SearchAlgorithm {
+    DIJKSTRA,
+    ASTAR,
+    BIDIRECTIONAL,
+    BIDIRECTIONAL_ASTAR
+};
+
+// Each solver owns its search workspaces, so one instance must not be shared
+// between threads; create one solver per thread over the same graph.
 class AllProblemsSolver {
 private:
     const DhakaGraph& graph;
+    mutable SearchWorkspace workspace;
+    mutable SearchWorkspace backwardWorkspace;
+    mutable SearchStats lastStats;
+    SearchAlgorithm algorithm;
+    const ContractionHierarchy* carHierarchy;
+    mutable TimeDependentRouter timeRouter;
+    mutable ParetoRouter paretoRouter;
+    mutable RaptorRouter raptorRouter;
+    RouteCache* routeCache;
+    const LiveTraffic* liveTraffic;
+    // Snapshot pinned by the running query (null for free flow)
+    mutable const TrafficSnapshot* live;
     
-    std::vector<Edge> dijkstra(const Location& source, const Location& destination,
-                               const std::set<TransportMode>& allowedModes,
-                               std::function<double(const Edge&)> costFunc) const {
-        std::map<Location, double> distances;
-        std::map<Location, Location> previous;
-        std::vector<Edge> allEdges;
-        std::map<Location, size_t> edgeIndices;
-        std::set<Location> visited;
-        
-        std::priority_queue<DijkstraNode, std::vector<DijkstraNode>, std::greater<DijkstraNode>> pq;
+    // Holds the current traffic snapshot for one query and points every
+    // search at its weights, so a publish mid-query changes nothing
+    class TrafficPin {
+        const AllProblemsSolver& solver;
+        std::shared_ptr<const TrafficSnapshot> snapshot;
+    public:
+        explicit TrafficPin(const AllProblemsSolver& s) : solver(s) {
+            if (solver.liveTraffic != nullptr) snapshot = solver.liveTraffic->snapshot();
+            solver.pinWeights(snapshot.get());
+        }
+        ~TrafficPin() { solver.pinWeights(nullptr); }
+    };
+    
+    void pinWeights(const TrafficSnapshot* snapshot) const {
+        live = snapshot;
+        const double* weights = snapshot != nullptr ? snapshot->weights.data() : nullptr;
+        timeRouter.setLiveWeights(weights);
+        paretoRouter.setLiveWeights(weights);
+    }
+    
+    template <typename CostModel>
+    double edgeCost(uint32_t e, TransportMode mode) const {
+        return liveEdgeCost<CostModel>(graph, live != nullptr ? live->weights.data() : nullptr, e, mode);
+    }
+    
+    template <typename CostModel>
+    std::vector<Edge> dijkstra(NodeId source, NodeId destination) const {
+        if (source == INVALID_NODE || destination == INVALID_NODE) return std::vector<Edge>();
         
-        distances[source] = 0.0;
-        pq.push(DijkstraNode(source, 0.0));
+        workspace.reset(graph.getLocationCount());
+        workspace.setSource(source);
         
-        while (!pq.empty()) {
-            DijkstraNode current = pq.top();
-            pq.pop();
-            
-            if (visited.count(current.location)) continue;
-            visited.insert(current.location);
+        while (!workspace.empty()) {
+            NodeId current = workspace.settleNext();
+            lastStats.settledNodes++;
             
-            if (current.location == destination) break;
+            if (current == destination) break;
             
-            for (const auto& edge : graph.getNeighbors(current.location)) {
-                if (allowedModes.find(edge.mode) == allowedModes.end()) continue;
+            double currentCost = workspace.distance(current);
+            for (uint32_t e = graph.edgeBegin(current); e < graph.edgeEnd(current); e++) {
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                double w = edgeCost<CostModel>(e, mode);
+                if (std::isinf(w)) continue;
                 
-                double cost = costFunc(edge);
-                double newDist = current.cost + cost;
+                DHAKA_COUNT(lastStats.edgesRelaxed, 1);
+                workspace.relax(graph.edgeTarget(e), currentCost + w, current, e);
+            }
+        }
+        
+        return timedExtractPath(workspace, source, destination);
+    }
+    
+    // Lower bound on cost per straight-line km for this cost model: the
+    // cheapest allowed rate, scaled by how far below the haversine distance
+    // an edge weight of that mode can go. Shrunk slightly so rounding never
+    // makes the heuristic inconsistent.
+    template <typename CostModel>
+    double heuristicScale() const {
+        double scale = std::numeric_limits<double>::infinity();
+        for (int m = 0; m < MODE_COUNT; m++) {
+            TransportMode mode = static_cast<TransportMode>(m);
+            double ratio = graph.getMinWeightRatio(mode);
+            if (!modeAllowed(CostModel::allowedModes, mode) || std::isinf(ratio)) continue;
+            scale = std::min(scale, CostModel::ratePerKm(mode) * ratio);
+        }
+        return std::isinf(scale) ? 0.0 : scale * (1 - 1e-9);
+    }
+    
+    template <typename CostModel>
+    std::vector<Edge> astar(NodeId source, NodeId destination) const {
+        if (source == INVALID_NODE || destination == INVALID_NODE) return std::vector<Edge>();
+        
+        const SpatialIndex& index = graph.getSpatialIndex();
+        double scale = heuristicScale<CostModel>();
+        
+        workspace.reset(graph.getLocationCount());
+        workspace.setSource(source, 0.0, scale * index.distanceBetween(source, destination));
+        
+        while (!workspace.empty()) {
+            NodeId current = workspace.settleNext();
+            lastStats.settledNodes++;
+            
+            if (current == destination) break;
+            
+            double currentCost = workspace.distance(current);
+            for (uint32_t e = graph.edgeBegin(current); e < graph.edgeEnd(current); e++) {
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                double w = edgeCost<CostModel>(e, mode);
+                if (std::isinf(w)) continue;
                 
-                if (distances.find(edge.end) == distances.end() || newDist < distances[edge.end]) {
-                    distances[edge.end] = newDist;
-                    previous[edge.end] = current.location;
-                    allEdges.push_back(edge);
-                    edgeIndices[edge.end] = allEdges.size() - 1;
-                    pq.push(DijkstraNode(edge.end, newDist));
+                NodeId next = graph.edgeTarget(e);
+                double d = currentCost + w;
+                DHAKA_COUNT(lastStats.edgesRelaxed, 1);
+                if (d < workspace.distance(next)) {
+                    workspace.relax(next, d, current, e, d + scale * index.distanceBetween(next, destination));
                 }
             }
         }
         
-        std::vector<Edge> path;
-        Location current = destination;
+        return timedExtractPath(workspace, source, destination);
+    }
+    
+    // Bidirectional Dijkstra, optionally goal-directed with the average
+    // potential pf(v) = (h_t(v) - h_s(v)) / 2 forward and -pf(v) backward,
+    // which keeps both searches consistent. The backward search walks the
+    // reverse CSR. It stops once the two queue minima sum to at least the
+    // best meeting cost found.
+    template <typename CostModel>
+    std::vector<Edge> bidirectional(NodeId source, NodeId destination, bool goalDirected) const {
+        if (source == INVALID_NODE || destination == INVALID_NODE) return std::vector<Edge>();
+        if (source == destination) return std::vector<Edge>();
         
-        while (current != source) {
-            if (previous.find(current) == previous.end()) {
-                return std::vector<Edge>();
-            }
-            if (edgeIndices.find(current) != edgeIndices.end()) {
-                path.push_back(allEdges[edgeIndices[current]]);
+        const SpatialIndex& index = graph.getSpatialIndex();
+        double halfScale = goalDirected ? heuristicScale<CostModel>() / 2 : 0.0;
+        auto potential = [&](NodeId v) {
+            if (halfScale == 0.0) return 0.0;
+            return halfScale * (index.distanceBetween(v, destination) - index.distanceBetween(v, source));
+        };
+        
+        SearchWorkspace& forward = workspace;
+        SearchWorkspace& backward = backwardWorkspace;
+        forward.reset(graph.getLocationCount());
+        backward.reset(graph.getLocationCount());
+        forward.setSource(source, 0.0, potential(source));
+        backward.setSource(destination, 0.0, -potential(destination));
+        
+        double best = std::numeric_limits<double>::infinity();
+        NodeId meet = INVALID_NODE;
+        
+        while (!forward.empty() && !backward.empty()) {
+            if (forward.minKey() + backward.minKey() >= best) break;
+            
+            if (forward.minKey() <= backward.minKey()) {
+                NodeId current = forward.settleNext();
+                lastStats.settledNodes++;
+                double currentCost = forward.distance(current);
+                
+                for (uint32_t e = graph.edgeBegin(current); e < graph.edgeEnd(current); e++) {
+                    TransportMode mode = graph.edgeMode(e);
+                    if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                    double w = edgeCost<CostModel>(e, mode);
+                    if (std::isinf(w)) continue;
+                    
+                    NodeId next = graph.edgeTarget(e);
+                    double d = currentCost + w;
+                    DHAKA_COUNT(lastStats.edgesRelaxed, 1);
+                    if (d < forward.distance(next)) {
+                        forward.relax(next, d, current, e, d + potential(next));
+                    }
+                    if (backward.reached(next)) {
+                        double total = forward.distance(next) + backward.distance(next);
+                        if (total < best) {
+                            best = total;
+                            meet = next;
+                        }
+                    }
+                }
+            } else {
+                NodeId current = backward.settleNext();
+                lastStats.settledNodes++;
+                double currentCost = backward.distance(current);
+                
+                for (uint32_t i = graph.inEdgeBegin(current); i < graph.inEdgeEnd(current); i++) {
+                    uint32_t e = graph.inEdgeId(i);
+                    TransportMode mode = graph.edgeMode(e);
+                    if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                    double w = edgeCost<CostModel>(e, mode);
+                    if (std::isinf(w)) continue;
+                    
+                    NodeId prev = graph.inEdgeSource(i);
+                    double d = currentCost + w;
+                    DHAKA_COUNT(lastStats.edgesRelaxed, 1);
+                    if (d < backward.distance(prev)) {
+                        backward.relax(prev, d, current, e, d - potential(prev));
+                    }
+                    if (forward.reached(prev)) {
+                        double total = forward.distance(prev) + backward.distance(prev);
+                        if (total < best) {
+                            best = total;
+                            meet = prev;
+                        }
+                    }
+                }
             }
-            current = previous[current];
         }
         
-        std::reverse(path.begin(), path.end());
+        if (meet == INVALID_NODE) return std::vector<Edge>();
+        
+        Stopwatch watch;
+        std::vector<Edge> path = extractPath(forward, source, meet);
+        for (NodeId current = meet; current != destination; current = backward.parentOf(current)) {
+            graph.appendEdge(current, backward.parentEdgeOf(current), path);
+        }
+        lastStats.pathMicros += watch.lapMicros();
         return path;
     }
     
-    RouteResult convertToResult(const std::vector<Edge>& edges, const Location& source, const Location& dest) const {
-        RouteResult result;
-        
-        Location nearestSource = edges.empty() ? source : edges.front().start;
-        Location nearestDest = edges.empty() ? dest : edges.back().end;
-        
-        double walkStart = haversineDistance(source, nearestSource);
-        double walkEnd = haversineDistance(nearestDest, dest);
+    template <typename CostModel>
+    std::vector<Edge> findPath(NodeId source, NodeId destination) const {
+        switch (algorithm) {
+            case SearchAlgorithm::DIJKSTRA: return dijkstra<CostModel>(source, destination);
+            case SearchAlgorithm::ASTAR: return astar<CostModel>(source, destination);
+            case SearchAlgorithm::BIDIRECTIONAL: return bidirectional<CostModel>(source, destination, false);
+            case SearchAlgorithm::BIDIRECTIONAL_ASTAR:
+            default: return bidirectional<CostModel>(source, destination, true);
+        }
+    }
+    
+    std::vector<Edge> extractPath(const SearchWorkspace& ws, NodeId source, NodeId destination) const {
+        std::vector<Edge> path;
+        if (!ws.reached(destination)) return path;
         
-        if (walkStart > 0.001) {
-            result.segments.push_back(std::make_pair(source, nearestSource));
-            result.modes.push_back(TransportMode::WALK);
-            result.distances.push_back(walkStart);
-            result.costs.push_back(0.0);
-            result.startNames.push_back("");
-            result.endNames.push_back("");
+        std::vector<NodeId> nodes;
+        for (NodeId current = destination; current != source; current = ws.parentOf(current)) {
+            nodes.push_back(current);
         }
         
+        for (size_t i = nodes.size(); i-- > 0;) {
+            graph.appendEdge(ws.parentOf(nodes[i]), ws.parentEdgeOf(nodes[i]), path);
+        }
+        return path;
+    }
+    
+    std::vector<Edge> timedExtractPath(const SearchWorkspace& ws, NodeId source, NodeId destination) const {
+        Stopwatch watch;
+        std::vector<Edge> path = extractPath(ws, source, destination);
+        lastStats.pathMicros += watch.lapMicros();
+        return path;
+    }
+    
+    // Bounded one-to-all Dijkstra for solveIsochrone: settles nodes until
+    // the cheapest open one is over budget and never queues one that is.
+    // Shape points along a chain edge cost the edge's share up to them.
+    template <typename CostModel>
+    void reachable(Isochrone& out) const {
+        if (out.source == INVALID_NODE) return;
+        double walk = haversineDistance(out.origin, graph.getLocation(out.source));
+        double start = CostModel::accessCost(walk > MIN_WALK_KM ? walk : 0.0);
+        if (start > out.budget) return;
         
-        if (!edges.empty()) {
-            TransportMode currentMode = edges[0].mode;
-            Location segStart = edges[0].start;
-            Location segEnd = edges[0].end;
-            double segDist = edges[0].distance;
+        workspace.reset(graph.getLocationCount());
+        workspace.setSource(out.source, start);
+        while (!workspace.empty() && workspace.minKey() <= out.budget) {
+            NodeId current = workspace.settleNext();
+            lastStats.settledNodes++;
+            double currentCost = workspace.distance(current);
+            ReachedNode reached = {current, currentCost};
+            out.nodes.push_back(reached);
             
-            for (size_t i = 1; i < edges.size(); i++) {
-                if (edges[i].mode == currentMode && edges[i].start == segEnd) {
-                    segEnd = edges[i].end;
-                    segDist += edges[i].distance;
-                } else {
-                    result.segments.push_back(std::make_pair(segStart, segEnd));
-                    result.modes.push_back(currentMode);
-                    result.distances.push_back(segDist);
-                    result.costs.push_back(0.0);
-                    result.startNames.push_back(graph.getStationName(segStart));
-                    result.endNames.push_back(graph.getStationName(segEnd));
-                    
-                    currentMode = edges[i].mode;
-                    segStart = edges[i].start;
-                    segEnd = edges[i].end;
-                    segDist = edges[i].distance;
+            for (uint32_t e = graph.edgeBegin(current); e < graph.edgeEnd(current); e++) {
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                double w = edgeCost<CostModel>(e, mode);
+                if (std::isinf(w)) continue;
+                
+                double along = 0.0;
+                double length = graph.edgeWeight(e);
+                for (uint32_t i = graph.shapeBegin(e); i + 1 < graph.shapeEnd(e); i++) {
+                    along += graph.shapeWeight(i);
+                    ReachedNode point = {graph.shapeTarget(i), currentCost + (length > 0.0 ? w * along / length : 0.0)};
+                    if (point.cost > out.budget) break;
+                    out.nodes.push_back(point);
                 }
+                
+                double d = currentCost + w;
+                if (d > out.budget) continue;
+                DHAKA_COUNT(lastStats.edgesRelaxed, 1);
+                workspace.relax(graph.edgeTarget(e), d, current, e);
             }
-            
-            result.segments.push_back(std::make_pair(segStart, segEnd));
-            result.modes.push_back(currentMode);
-            result.distances.push_back(segDist);
-            result.costs.push_back(0.0);
-            result.startNames.push_back(graph.getStationName(segStart));
-            result.endNames.push_back(graph.getStationName(segEnd));
         }
         
-        if (walkEnd > 0.001) {
-            result.segments.push_back(std::make_pair(nearestDest, dest));
-            result.modes.push_back(TransportMode::WALK);
-            result.distances.push_back(walkEnd);
-            result.costs.push_back(0.0);
-            result.startNames.push_back("");
-            result.endNames.push_back("");
+        // A shape point on a two-way chain is reached from both ends; keep
+        // the cheaper
+        std::sort(out.nodes.begin(), out.nodes.end());
+        size_t kept = 0;
+        for (size_t i = 0; i < out.nodes.size(); i++) {
+            if (kept == 0 || out.nodes[kept - 1].node != out.nodes[i].node) out.nodes[kept++] = out.nodes[i];
         }
-        
-        return result;
+        out.nodes.resize(kept);
     }
-
-public:
-    AllProblemsSolver(const DhakaGraph& g) : graph(g) {}
     
-    // PROBLEM 1
-    RouteResult solveProblem1(const Location& source, const Location& dest) const {
-        Location nearestSrc = graph.findNearestLocation(source);
-        Location nearestDst = graph.findNearestLocation(dest);
+    // Fills `route` from a network path between the snapped nodes, adding
+    // the walks on and off it; consecutive edges of one mode form one
+    // segment. With timing, also fills per-segment clock times: the walk to
+    // the network starts at `departure` and the walk off it starts on
+    // arrival. Costs are left at zero for the caller to price.
+    void buildRoute(const std::vector<Edge>& edges, const Location& source, const Location& dest,
+                    CompactRoute& route, const TimedPath* timing = nullptr, double departure = 0.0) const {
+        route.clear();
+        route.source = source;
+        route.destination = dest;
+        route.departure = departure;
+        if (edges.empty()) return;
         
-        auto costFunc = [](const Edge& e) { return e.distance; };
-        std::set<TransportMode> modes;
-        modes.insert(TransportMode::CAR);
+        route.nodes.push_back(graph.findNode(edges.front().start));
+        for (size_t i = 0; i < edges.size(); i++) {
+            route.nodes.push_back(graph.findNode(edges[i].end));
+        }
         
-        auto edges = dijkstra(nearestSrc, nearestDst, modes, costFunc);
-        RouteResult result = convertToResult(edges, source, dest);
+        const TravelTimeModel& model = timeRouter.getModel();
+        double walkStart = haversineDistance(source, edges.front().start);
+        double walkEnd = haversineDistance(edges.back().end, dest);
+        double clock = departure;
         
-        for (size_t i = 0; i < result.distances.size(); i++) {
-            result.totalValue += result.distances[i];
+        if (walkStart > MIN_WALK_KM) {
+            double arrive = timing != nullptr ? clock + model.travelMinutes(walkStart, TransportMode::WALK) : 0.0;
+            route.addSegment(CompactRoute::QUERY_POINT, 0, TransportMode::WALK, walkStart, clock, arrive);
+            clock = arrive;
         }
         
-        return result;
+        size_t first = 0;
+        double segDist = edges[0].distance;
+        for (size_t i = 1; i <= edges.size(); i++) {
+            if (i < edges.size() && edges[i].mode == edges[first].mode) {
+                segDist += edges[i].distance;
+                continue;
+            }
+            route.addSegment(static_cast<uint32_t>(first), static_cast<uint32_t>(i), edges[first].mode, segDist,
+                             timing != nullptr ? timing->departTimes[first] : 0.0,
+                             timing != nullptr ? timing->arriveTimes[i - 1] : 0.0);
+            if (i < edges.size()) {
+                first = i;
+                segDist = edges[i].distance;
+            }
+        }
+        if (timing != nullptr) clock = timing->arriveTimes.back();
+        
+        if (walkEnd > MIN_WALK_KM) {
+            double arrive = timing != nullptr ? clock + model.travelMinutes(walkEnd, TransportMode::WALK) : 0.0;
+            route.addSegment(static_cast<uint32_t>(route.nodes.size() - 1), CompactRoute::QUERY_POINT,
+                             TransportMode::WALK, walkEnd, clock, arrive);
+        }
+        route.timed = timing != nullptr;
+    }
+
+    // Prices every segment with the cost model; totalValue is the fare
+    template <typename CostModel>
+    static void priceRoute(CompactRoute& route) {
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            route.segments[i].cost = CostModel::cost(route.segments[i].distance, route.segments[i].mode);
+            route.totalValue += route.segments[i].cost;
+        }
+    }
+
+    // The path search() finds between two snapped nodes, served from the
+    // route cache when one is set and already holds it
+    template <typename Search>
+    std::vector<Edge> cachedPath(uint32_t problem, NodeId source, NodeId destination, Search search) const {
+        if (routeCache == nullptr) return search();
+        
+        RouteCache::Key key = RouteCache::makeKey(source, destination, problem,
+                                                  live != nullptr ? live->version : 0);
+        CompactPath compact;
+        if (routeCache->lookup(key, compact)) {
+            return compact.decode(graph);
+        }
+        
+        std::vector<Edge> edges = search();
+        if (CompactPath::encode(graph, source, edges, compact)) routeCache->insert(key, compact);
+        return edges;
+    }
+
+    // Splits the time since the last lap between search and path building,
+    // given the path time the search itself recorded
+    void lapSearch(Stopwatch& watch) const {
+        lastStats.searchMicros = watch.lapMicros() - lastStats.pathMicros;
     }
     
-    RouteResult solveProblem2(const Location& source, const Location& dest) const {
-        const double CAR_COST = 20.0;
-        const double METRO_COST = 5.0;
+    void recordStats(int problem) const {
+        lastStats.heapPushes = workspace.getHeapPushes() + backwardWorkspace.getHeapPushes();
+        lastStats.heapPops = workspace.getHeapPops() + backwardWorkspace.getHeapPops();
+        StatsRegistry::global().recordQuery(problem, lastStats);
+    }
+    
+    void routeCar(const Location& source, const Location& dest, CompactRoute& route) const {
+        Stopwatch watch;
+        NodeId nearestSrc = graph.findNearestNode(source);
+        NodeId nearestDst = graph.findNearestNode(dest);
+        lastStats.snapMicros = watch.lapMicros();
         
-        Location nearestSrc = graph.findNearestLocation(source);
-        Location nearestDst = graph.findNearestLocation(dest);
+        // Under live traffic only the snapshot's customized hierarchy fits
+        const ContractionHierarchy* ch = live != nullptr ? live->carHierarchy.get() : carHierarchy;
+        std::vector<Edge> edges = cachedPath(1, nearestSrc, nearestDst, [&]() -> std::vector<Edge> {
+            if (ch != nullptr && ch->getMode() == TransportMode::CAR) {
+                return ch->query(nearestSrc, nearestDst, workspace, backwardWorkspace,
+                                 lastStats.settledNodes);
+            }
+            return findPath<CarDistanceCost>(nearestSrc, nearestDst);
+        });
+        lapSearch(watch);
+        buildRoute(edges, source, dest, route);
         
-        auto costFunc = [CAR_COST, METRO_COST](const Edge& e) {
-            if (e.mode == TransportMode::CAR) return e.distance * CAR_COST;
-            if (e.mode == TransportMode::METRO) return e.distance * METRO_COST;
-            return 0.0;
-        };
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            route.totalValue += route.segments[i].distance;
+        }
+        lastStats.pathMicros += watch.lapMicros();
+    }
+
+    template <typename CostModel>
+    void routeFare(const Location& source, const Location& dest, uint32_t problem, CompactRoute& route) const {
+        Stopwatch watch;
+        NodeId nearestSrc = graph.findNearestNode(source);
+        NodeId nearestDst = graph.findNearestNode(dest);
+        lastStats.snapMicros = watch.lapMicros();
         
-        std::set<TransportMode> modes;
-        modes.insert(TransportMode::CAR);
-        modes.insert(TransportMode::METRO);
+        auto edges = cachedPath(problem, nearestSrc, nearestDst, [&]() {
+            return findPath<CostModel>(nearestSrc, nearestDst);
+        });
+        lapSearch(watch);
+        buildRoute(edges, source, dest, route);
+        priceRoute<CostModel>(route);
+        lastStats.pathMicros += watch.lapMicros();
+    }
+
+    enum class TimedObjective { CHEAPEST, FASTEST, DEADLINE };
+    
+    void routeTimed(const Location& source, const Location& dest, TimedObjective objective,
+                    double departure, double deadline, CompactRoute& route) const {
+        route.clear();
+        route.source = source;
+        route.destination = dest;
+        Stopwatch watch;
+        NodeId nearestSrc = graph.findNearestNode(source);
+        NodeId nearestDst = graph.findNearestNode(dest);
+        lastStats.snapMicros = watch.lapMicros();
+        if (nearestSrc == INVALID_NODE || nearestDst == INVALID_NODE) return;
         
-        auto edges = dijkstra(nearestSrc, nearestDst, modes, costFunc);
-        RouteResult result = convertToResult(edges, source, dest);
+        const TravelTimeModel& model = timeRouter.getModel();
+        double walkStart = haversineDistance(source, graph.getLocation(nearestSrc));
+        double walkEnd = haversineDistance(graph.getLocation(nearestDst), dest);
+        double startTime = departure + (walkStart > MIN_WALK_KM ? model.travelMinutes(walkStart, TransportMode::WALK) : 0.0);
+        double endWalk = walkEnd > MIN_WALK_KM ? model.travelMinutes(walkEnd, TransportMode::WALK) : 0.0;
         
-        for (size_t i = 0; i < result.distances.size(); i++) {
-            if (result.modes[i] == TransportMode::CAR) {
-                result.costs[i] = result.distances[i] * CAR_COST;
-            } else if (result.modes[i] == TransportMode::METRO) {
-                result.costs[i] = result.distances[i] * METRO_COST;
-            }
-            result.totalValue += result.costs[i];
+        TimedPath path;
+        switch (objective) {
+            case TimedObjective::CHEAPEST:
+                path = timeRouter.cheapest<AllModesFareCost>(nearestSrc, nearestDst, startTime);
+                break;
+            case TimedObjective::FASTEST:
+                path = timeRouter.fastest<AllModesFareCost>(nearestSrc, nearestDst, startTime);
+                break;
+            case TimedObjective::DEADLINE:
+            default:
+                path = timeRouter.cheapestWithinDeadline<AllModesFareCost>(nearestSrc, nearestDst, startTime,
+                                                                           deadline - endWalk);
+                break;
         }
+        lastStats.settledNodes = timeRouter.getSettledCount();
+        lapSearch(watch);
+        if (!path.found) return;
         
-        return result;
+        buildRoute(path.edges, source, dest, route, &path, departure);
+        priceRoute<AllModesFareCost>(route);
+        if (objective == TimedObjective::FASTEST) {
+            route.totalValue = route.found() ? route.segments.back().arriveTime - departure : 0.0;
+        }
+        lastStats.pathMicros += watch.lapMicros();
+    }
+
+public:
+    AllProblemsSolver(const DhakaGraph& g, SearchAlgorithm algo = SearchAlgorithm::BIDIRECTIONAL)
+        : graph(g), algorithm(algo), carHierarchy(nullptr), timeRouter(g), paretoRouter(g),
+          routeCache(nullptr), liveTraffic(nullptr), live(nullptr) {}
+    
+    // When set, Problem 1 queries run on this car-mode hierarchy instead of
+    // searching the full graph
+    void setCarHierarchy(const ContractionHierarchy* ch) { carHierarchy = ch; }
+    
+    // When set, Problems 1-3 reuse routes between the same snapped nodes;
+    // the cache may be shared by solvers on other threads
+    void setRouteCache(RouteCache* cache) { routeCache = cache; }
+    
+    // When set, every query pins the current traffic snapshot: closed
+    // edges are avoided, Problem 1 and the timed problems see slowdowns,
+    // and Problem 1 uses the snapshot's re-customized hierarchy
+    void setLiveTraffic(const LiveTraffic* traffic) { liveTraffic = traffic; }
+    
+    // Metro and bus lines for solveTransit; null disables it
+    void setTransitNetwork(const TransitNetwork* network) { raptorRouter.setNetwork(network); }
+    const TransitNetwork* getTransitNetwork() const { return raptorRouter.getNetwork(); }
+    
+    // Caps for solveTransit (see RaptorRouter)
+    void setTransitLimits(uint32_t maxTransfers, double accessRadiusKm) {
+        raptorRouter.setLimits(maxTransfers, accessRadiusKm);
+    }
+    
+    // Caps for solveParetoFrontier (see ParetoRouter)
+    void setParetoLimits(uint32_t labelsPerState, uint32_t maxSwitches) {
+        paretoRouter.setLimits(labelsPerState, maxSwitches);
+    }
+    
+    // Speeds and schedules used by Problems 4-6
+    void setTravelTimeModel(const TravelTimeModel& model) { timeRouter.setModel(model); }
+    const TravelTimeModel& getTravelTimeModel() const { return timeRouter.getModel(); }
+    
+    void setSearchAlgorithm(SearchAlgorithm algo) { algorithm = algo; }
+    SearchAlgorithm getSearchAlgorithm() const { return algorithm; }
+    
+    // Statistics of the most recent query. Each query is also added to
+    // StatsRegistry::global() unless built with DHAKA_NO_INSTRUMENTATION.
+    const SearchStats& getLastSearchStats() const { return lastStats; }
+    
+    // Solves Problem 1-6 into `route`, reusing its buffers, so a caller
+    // looping over many queries allocates almost nothing per result.
+    // departure and deadline are only read by Problems 4-6.
+    void solveRoute(int problem, const Location& source, const Location& dest, CompactRoute& route,
+                    double departure = DEFAULT_DEPARTURE_TIME,
+                    double deadline = std::numeric_limits<double>::infinity()) const {
+        TrafficPin pin(*this);
+        lastStats = SearchStats();
+        workspace.clearCounters();
+        backwardWorkspace.clearCounters();
+        switch (problem) {
+            case 1: routeCar(source, dest, route); break;
+            case 2: routeFare<CarMetroFareCost>(source, dest, 2, route); break;
+            case 3: routeFare<AllModesFareCost>(source, dest, 3, route); break;
+            case 4: routeTimed(source, dest, TimedObjective::CHEAPEST, departure, 0.0, route); break;
+            case 5: routeTimed(source, dest, TimedObjective::FASTEST, departure, 0.0, route); break;
+            case 6: routeTimed(source, dest, TimedObjective::DEADLINE, departure, deadline, route); break;
+            default:
+                route.clear();
+                route.source = source;
+                route.destination = dest;
+                break;
+        }
+        recordStats(problem);
+    }
+    
+    // PROBLEM 1
+    RouteResult solveProblem1(const Location& source, const Location& dest) const {
+        CompactRoute route;
+        solveRoute(1, source, dest, route);
+        return route.toResult(graph);
+    }
+    
+    RouteResult solveProblem2(const Location& source, const Location& dest) const {
+        CompactRoute route;
+        solveRoute(2, source, dest, route);
+        return route.toResult(graph);
     }
     
     
     RouteResult solveProblem3(const Location& source, const Location& dest) const {
-        const double CAR_COST = 20.0;
-        const double METRO_COST = 5.0;
-        const double BUS_COST = 7.0;
-        
-        Location nearestSrc = graph.findNearestLocation(source);
-        Location nearestDst = graph.findNearestLocation(dest);
-        
-        auto costFunc = [CAR_COST, METRO_COST, BUS_COST](const Edge& e) {
-            if (e.mode == TransportMode::CAR) return e.distance * CAR_COST;
-            if (e.mode == TransportMode::METRO) return e.distance * METRO_COST;
-            if (e.mode == TransportMode::BUS_BIKOLPO || e.mode == TransportMode::BUS_UTTARA)
-                return e.distance * BUS_COST;
-            return 0.0;
-        };
+        CompactRoute route;
+        solveRoute(3, source, dest, route);
+        return route.toResult(graph);
+    }
+    
+    // Every route not beaten on all of fare, distance and mode switches,
+    // cheapest first, from a single search. totalValue is the fare.
+    std::vector<RouteResult> solveParetoFrontier(const Location& source, const Location& dest) const {
+        TrafficPin pin(*this);
+        lastStats = SearchStats();
+        workspace.clearCounters();
+        backwardWorkspace.clearCounters();
+        Stopwatch watch;
+        NodeId nearestSrc = graph.findNearestNode(source);
+        NodeId nearestDst = graph.findNearestNode(dest);
+        lastStats.snapMicros = watch.lapMicros();
         
-        std::set<TransportMode> modes;
-        modes.insert(TransportMode::CAR);
-        modes.insert(TransportMode::METRO);
-        modes.insert(TransportMode::BUS_BIKOLPO);
-        modes.insert(TransportMode::BUS_UTTARA);
-        
-        auto edges = dijkstra(nearestSrc, nearestDst, modes, costFunc);
-        RouteResult result = convertToResult(edges, source, dest);
-        
-        for (size_t i = 0; i < result.distances.size(); i++) {
-            if (result.modes[i] == TransportMode::CAR) {
-                result.costs[i] = result.distances[i] * CAR_COST;
-            } else if (result.modes[i] == TransportMode::METRO) {
-                result.costs[i] = result.distances[i] * METRO_COST;
-            } else if (result.modes[i] == TransportMode::BUS_BIKOLPO || 
-                       result.modes[i] == TransportMode::BUS_UTTARA) {
-                result.costs[i] = result.distances[i] * BUS_COST;
-            }
-            result.totalValue += result.costs[i];
+        std::vector<ParetoPath> paths = paretoRouter.frontierRoutes<AllModesFareCost>(nearestSrc, nearestDst);
+        lastStats.settledNodes = paretoRouter.getSettledCount();
+        lapSearch(watch);
+        
+        std::vector<RouteResult> results;
+        CompactRoute route;
+        for (size_t p = 0; p < paths.size(); p++) {
+            buildRoute(paths[p].edges, source, dest, route);
+            priceRoute<AllModesFareCost>(route);
+            results.push_back(route.toResult(graph));
         }
+        lastStats.pathMicros += watch.lapMicros();
+        recordStats(0);
+        return results;
+    }
+    
+    // Everything reachable from `origin` within `budget` under the Problem
+    // 1-3 cost model (km for 1, Tk for 2 and 3), from one bounded sweep;
+    // fills `out`, reusing its buffer. Problem 1 sweeps the graph rather
+    // than the hierarchy, which only helps point-to-point queries.
+    void solveIsochrone(int problem, const Location& origin, double budget, Isochrone& out) const {
+        TrafficPin pin(*this);
+        lastStats = SearchStats();
+        workspace.clearCounters();
+        backwardWorkspace.clearCounters();
+        out.clear();
+        out.origin = origin;
+        out.problem = problem;
+        out.budget = budget;
+        Stopwatch watch;
+        out.source = graph.findNearestNode(origin);
+        lastStats.snapMicros = watch.lapMicros();
         
-        return result;
+        switch (problem) {
+            case 1: reachable<CarDistanceCost>(out); break;
+            case 2: reachable<CarMetroFareCost>(out); break;
+            case 3: reachable<AllModesFareCost>(out); break;
+            default: break;
+        }
+        lastStats.searchMicros = watch.lapMicros();
+        recordStats(0);
+    }
+    
+    // Metro and bus journeys by earliest arrival, one per number of trips
+    // that arrives sooner than any journey with fewer (fewest trips first),
+    // from a single round-based search over the transit lines. Walks to the
+    // first stop and from the last are capped by the access radius, and
+    // road edges are never used. totalValue is the journey time in minutes.
+    std::vector<RouteResult> solveTransit(const Location& source, const Location& dest,
+                                          double departure = DEFAULT_DEPARTURE_TIME) const {
+        lastStats = SearchStats();
+        workspace.clearCounters();
+        backwardWorkspace.clearCounters();
+        Stopwatch watch;
+        std::vector<TransitJourney> journeys;
+        raptorRouter.search(timeRouter.getModel(), source, dest, departure, journeys);
+        lastStats.settledNodes = raptorRouter.getScannedStops();
+        lapSearch(watch);
+        
+        std::vector<RouteResult> results;
+        CompactRoute route;
+        for (size_t j = 0; j < journeys.size(); j++) {
+            buildRoute(journeys[j].path.edges, source, dest, route, &journeys[j].path, departure);
+            priceRoute<AllModesFareCost>(route);
+            route.totalValue = journeys[j].arrival - departure;
+            results.push_back(route.toResult(graph));
+        }
+        lastStats.pathMicros += watch.lapMicros();
+        recordStats(0);
+        return results;
+    }
+    
+    // PROBLEM 4: cheapest fare for a given departure time, honouring the
+    // schedules (ties go to the earlier arrival)
+    RouteResult solveProblem4(const Location& source, const Location& dest,
+                              double departure = DEFAULT_DEPARTURE_TIME) const {
+        CompactRoute route;
+        solveRoute(4, source, dest, route, departure);
+        return route.toResult(graph);
     }
     
-    RouteResult solveProblem4(const Location& source, const Location& dest) const {
-        return solveProblem3(source, dest);
+    // PROBLEM 5: earliest arrival; totalValue is the journey time in minutes
+    RouteResult solveProblem5(const Location& source, const Location& dest,
+                              double departure = DEFAULT_DEPARTURE_TIME) const {
+        CompactRoute route;
+        solveRoute(5, source, dest, route, departure);
+        return route.toResult(graph);
     }
     
-    RouteResult solveProblem5(const Location& source, const Location& dest) const {
-        return solveProblem3(source, dest);
+    // PROBLEM 6: cheapest fare arriving by `deadline`; no segments if no
+    // route makes it
+    RouteResult solveProblem6(const Location& source, const Location& dest,
+                              double departure, double deadline) const {
+        CompactRoute route;
+        solveRoute(6, source, dest, route, departure, deadline);
+        return route.toResult(graph);
     }
     
     RouteResult solveProblem6(const Location& source, const Location& dest) const {
-        return solveProblem3(source, dest);
+        return solveProblem6(source, dest, DEFAULT_DEPARTURE_TIME, std::numeric_limits<double>::infinity());
     }
 };
 
@@ -0,0 +1,238 @@
+#ifndef BATCH_SOLVER_H
+#define BATCH_SOLVER_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "ContractionHierarchy.h"
+#include "AllProblemsSolver.h"
+#include "ThreadPool.h"
+#include "RouteCache.h"
+#include "RouteWriter.h"
+#include <memory>
+
+// One origin-destination query for solveBatch. departure and deadline are
+// only read by Problems 4-6 (deadline only by 6).
+struct BatchQuery {
+    Location source;
+    Location destination;
+    int problem;
+    double departure;
+    double deadline;
+
+    BatchQuery()
+        : problem(1), departure(DEFAULT_DEPARTURE_TIME), deadline(std::numeric_limits<double>::infinity()) {}
+};
+
+// Solves many queries over one shared, read-only DhakaGraph. Each pool
+// worker owns its own AllProblemsSolver (and so its own workspaces), so
+// queries never contend for search state; results come back in input order.
+class BatchSolver {
+private:
+    const DhakaGraph& graph;
+    ThreadPool pool;
+    std::vector<std::unique_ptr<AllProblemsSolver>> solvers;
+
+    // Queries per pool task: enough to amortise scheduling, small enough
+    // for stealing to even out long and short routes
+    static const size_t GRAIN = 16;
+
+public:
+    // threads 0 means one per hardware thread; carHierarchy may be null
+    BatchSolver(const DhakaGraph& g, size_t threads = 0, const ContractionHierarchy* carHierarchy = nullptr)
+        : graph(g), pool(threads) {
+        for (size_t i = 0; i < pool.size(); i++) {
+            solvers.push_back(std::unique_ptr<AllProblemsSolver>(new AllProblemsSolver(graph)));
+            solvers.back()->setCarHierarchy(carHierarchy);
+        }
+    }
+
+    size_t getThreadCount() const { return pool.size(); }
+
+    // Shares one route cache between every worker's solver; null disables it
+    void setRouteCache(RouteCache* cache) {
+        for (size_t i = 0; i < solvers.size(); i++) {
+            solvers[i]->setRouteCache(cache);
+        }
+    }
+
+    // Points every worker at the same live traffic; null means free flow
+    void setLiveTraffic(const LiveTraffic* traffic) {
+        for (size_t i = 0; i < solvers.size(); i++) {
+            solvers[i]->setLiveTraffic(traffic);
+        }
+    }
+
+    // Results in input order, as compact routes (node IDs and segment
+    // boundaries), so each query costs at most two allocations
+    std::vector<CompactRoute> solveBatch(const std::vector<BatchQuery>& queries) {
+        std::vector<CompactRoute> results(queries.size());
+        pool.parallelFor(queries.size(), GRAIN, [&](size_t i, size_t worker) {
+            const BatchQuery& query = queries[i];
+            solvers[worker]->solveRoute(query.problem, query.source, query.destination, results[i],
+                                        query.departure, query.deadline);
+        });
+        return results;
+    }
+
+    // One isochrone per origin (see AllProblemsSolver::solveIsochrone), in
+    // input order
+    std::vector<Isochrone> solveIsochrones(const std::vector<Location>& origins, int problem, double budget) {
+        std::vector<Isochrone> results(origins.size());
+        pool.parallelFor(origins.size(), 1, [&](size_t i, size_t worker) {
+            solvers[worker]->solveIsochrone(problem, origins[i], budget, results[i]);
+        });
+        return results;
+    }
+
+    // Coverage of many origins at once: every origin's isochrone is folded
+    // into `grid` (lowest cost per cell over all origins) and then dropped,
+    // so memory stays flat however many origins there are. reached[i] is
+    // how many nodes origin i reaches.
+    void solveCoverage(const std::vector<Location>& origins, int problem, double budget, IsochroneGrid& grid,
+                       std::vector<size_t>& reached) {
+        reached.assign(origins.size(), 0);
+        std::vector<Isochrone> isochrones(pool.size());
+        std::vector<IsochroneGrid> grids(pool.size(), grid);
+        pool.parallelFor(origins.size(), 1, [&](size_t i, size_t worker) {
+            solvers[worker]->solveIsochrone(problem, origins[i], budget, isochrones[worker]);
+            grids[worker].add(graph, isochrones[worker]);
+            reached[i] = isochrones[worker].size();
+        });
+        for (size_t w = 0; w < grids.size(); w++) grid.merge(grids[w]);
+    }
+
+    // One query from the fields of a "srcLon,srcLat,dstLon,dstLat,problem
+    // [,departure[,deadline]]" line, with times as HH:MM or minutes
+    static bool parseQuery(const std::vector<CSVField>& fields, BatchQuery& query) {
+        double problem;
+        bool ok = fields.size() >= 5 && fields.size() <= 7 &&
+                  CSVParser::parseDouble(fields[0], query.source.lon) &&
+                  CSVParser::parseDouble(fields[1], query.source.lat) &&
+                  CSVParser::parseDouble(fields[2], query.destination.lon) &&
+                  CSVParser::parseDouble(fields[3], query.destination.lat) &&
+                  CSVParser::parseDouble(fields[4], problem) && problem >= 1 && problem <= 6;
+        if (ok && fields.size() >= 6) ok = parseClock(fields[5].str(), query.departure);
+        if (ok && fields.size() >= 7) ok = parseClock(fields[6].str(), query.deadline);
+        if (ok) query.problem = static_cast<int>(problem);
+        return ok;
+    }
+
+    // One query per line (see parseQuery); blank lines and # comments are
+    // skipped
+    static bool readQueries(const std::string& filename, std::vector<BatchQuery>& queries) {
+        std::ifstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return false;
+        }
+
+        std::string line;
+        std::vector<CSVField> fields;
+        size_t lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#' || line == "\r") continue;
+
+            CSVParser::splitFields(line.data(), line.data() + line.size(), fields);
+            BatchQuery query;
+            if (!parseQuery(fields, query)) {
+                std::cerr << "Error: " << filename << ":" << lineNumber << ": malformed query" << std::endl;
+                return false;
+            }
+            queries.push_back(query);
+        }
+        return true;
+    }
+
+    // One CSV row per query, in input order:
+    // index,problem,found,value,distance_km,segments,modes
+    // or, when the file name ends in .json, a JSON array of
+    // {"index", "problem", "route"} objects. Rows are formatted into one
+    // reused buffer and flushed in large blocks.
+    static bool writeResults(const std::string& filename, const DhakaGraph& graph,
+                             const std::vector<BatchQuery>& queries, const std::vector<CompactRoute>& results) {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << filename << std::endl;
+            return false;
+        }
+
+        bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+        RouteWriter writer(graph);
+        writer.append(json ? "[\n" : "index,problem,found,value,distance_km,segments,modes\n");
+        for (size_t i = 0; i < results.size(); i++) {
+            const CompactRoute& r = results[i];
+            if (json) {
+                writer.append("{\"index\":").appendUnsigned(i);
+                writer.append(",\"problem\":").appendUnsigned(static_cast<uint64_t>(queries[i].problem));
+                writer.append(",\"route\":");
+                writer.appendJSON(r);
+                writer.append(i + 1 < results.size() ? "},\n" : "}\n");
+            } else {
+                writer.appendUnsigned(i).append(",").appendUnsigned(static_cast<uint64_t>(queries[i].problem));
+                writer.append(r.found() ? ",1," : ",0,").appendFixed(r.totalValue, 4);
+                writer.append(",").appendFixed(r.totalDistance(), 4);
+                writer.append(",").appendUnsigned(r.segments.size()).append(",");
+                for (size_t s = 0; s < r.segments.size(); s++) {
+                    if (s > 0) writer.append("|");
+                    writer.append(transportModeToString(r.segments[s].mode));
+                }
+                writer.append("\n");
+            }
+            if (writer.size() >= RouteWriter::FLUSH_BYTES && !writer.flush(file)) return false;
+        }
+        if (json) writer.append("]\n");
+        return writer.flush(file);
+    }
+
+    // Every found route with its full geometry in one file: a GeoJSON
+    // FeatureCollection (features carry the query index as "route"), or a
+    // KML document with one folder per query when the name ends in .kml
+    static bool writeGeometry(const std::string& filename, const DhakaGraph& graph,
+                              const std::vector<BatchQuery>& queries, const std::vector<CompactRoute>& results) {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << filename << std::endl;
+            return false;
+        }
+
+        bool kml = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".kml") == 0;
+        RouteWriter writer(graph);
+        if (kml) writer.beginKML(filename);
+        else writer.beginGeoJSON();
+        std::string name;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (!results[i].found()) continue;
+            if (kml) {
+                name = "Query " + std::to_string(i) + " (Problem " + std::to_string(queries[i].problem) + ")";
+                writer.appendKMLRoute(results[i], name);
+            } else {
+                writer.appendGeoJSONRoute(results[i], i);
+            }
+            if (writer.size() >= RouteWriter::FLUSH_BYTES && !writer.flush(file)) return false;
+        }
+        if (kml) writer.endKML();
+        else writer.endGeoJSON();
+        return writer.flush(file);
+    }
+
+    // A coverage grid as GeoJSON, or KML when the name ends in .kml
+    static bool writeCoverage(const std::string& filename, const DhakaGraph& graph, const IsochroneGrid& grid,
+                              double budget) {
+        bool kml = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".kml") == 0;
+        RouteWriter writer(graph);
+        if (kml) {
+            writer.beginKML(filename);
+            writer.appendKMLGrid(grid, budget, "coverage");
+            writer.endKML();
+        } else {
+            writer.beginGeoJSON();
+            writer.appendGeoJSONGrid(grid, budget);
+            writer.endGeoJSON();
+        }
+        return writer.writeFile(filename);
+    }
+};
+
+#endif // BATCH_SOLVER_H
@@ -3,10 +3,52 @@
 
 #include "DhakaRouting.h"
 #include "DhakaGraph.h"
+#include "MappedFile.h"
+#include "Instrumentation.h"
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
 
 
 
+// A field of a mapped CSV line, as a [begin, end) range into the file
+struct CSVField {
+    const char* begin;
+    const char* end;
+
+    CSVField(const char* b = nullptr, const char* e = nullptr) : begin(b), end(e) {}
+    std::string str() const { return std::string(begin, end); }
+};
+
+// One newline-aligned slice of a road file, parsed on its own thread. The
+// polyline of line i is coords[lineEnds[i-1] .. lineEnds[i]).
+struct RoadChunk {
+    const char* begin;
+    const char* end;
+    std::vector<Location> coords;
+    std::vector<uint32_t> lineEnds;
+    std::vector<double> distances;
+};
+
 class CSVParser {
+private:
+    // Slices smaller than this are not worth a thread
+    static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    static bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    // strtod on a terminated copy, for inputs outside the fast path
+    static bool parseDoubleSlow(const char* begin, const char* end, double& value) {
+        std::string copy(begin, end);
+        char* stop = nullptr;
+        errno = 0;
+        value = std::strtod(copy.c_str(), &stop);
+        return stop != copy.c_str() && errno != ERANGE;
+    }
+
 public:
     static std::vector<std::string> parseLine(const std::string& line) {
         std::vector<std::string> tokens;
@@ -19,120 +61,262 @@ public:
         
         return tokens;
     }
+
+    // Splits [begin, end) on commas without copying. Matches parseLine: a
+    // trailing comma does not produce an empty last field.
+    static void splitFields(const char* begin, const char* end, std::vector<CSVField>& fields) {
+        fields.clear();
+        const char* start = begin;
+        for (const char* p = begin; p != end; p++) {
+            if (*p == ',') {
+                fields.push_back(CSVField(start, p));
+                start = p + 1;
+            }
+        }
+        if (start != end) fields.push_back(CSVField(start, end));
+    }
+
+    // Accepts what std::stod accepts (leading whitespace, a numeric prefix).
+    // Decimal inputs with at most 15 significant digits and a power of ten
+    // within 1e22 are exact in double arithmetic, so one multiply or divide
+    // rounds correctly; anything else goes through strtod.
+    static bool parseDouble(const char* begin, const char* end, double& value) {
+        static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char* p = begin;
+        while (p != end && isSpace(*p)) p++;
+        bool negative = false;
+        if (p != end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool any = false;
+        while (p != end && *p >= '0' && *p <= '9') {
+            if (mantissa != 0 || *p != '0') {
+                if (digits >= 15) return parseDoubleSlow(begin, end, value);
+                mantissa = mantissa * 10 + (*p - '0');
+                digits++;
+            }
+            p++;
+            any = true;
+        }
+        if (p != end && *p == '.') {
+            p++;
+            while (p != end && *p >= '0' && *p <= '9') {
+                if (mantissa != 0 || *p != '0') {
+                    if (digits >= 15) return parseDoubleSlow(begin, end, value);
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits++;
+                }
+                exponent--;
+                p++;
+                any = true;
+            }
+        }
+        if (!any) return parseDoubleSlow(begin, end, value);
+        if (p != end && (*p == 'e' || *p == 'E')) return parseDoubleSlow(begin, end, value);
+
+        if (exponent < -22) return parseDoubleSlow(begin, end, value);
+        value = static_cast<double>(mantissa) / POW10[-exponent];
+        if (negative) value = -value;
+        return true;
+    }
+
+    static bool parseDouble(const CSVField& field, double& value) {
+        return parseDouble(field.begin, field.end, value);
+    }
+
+    // Reads the lon,lat pairs between the name column and the last two
+    // columns, stopping at the first unparsable pair
+    static void parseCoordinates(const std::vector<CSVField>& fields, std::vector<Location>& coords) {
+        for (size_t i = 1; i + 1 < fields.size() - 2; i += 2) {
+            double lon, lat;
+            if (!parseDouble(fields[i], lon) || !parseDouble(fields[i + 1], lat)) break;
+            coords.push_back(Location(lat, lon));
+        }
+    }
+    
+    // Interning stage: maps each polyline vertex to its stable node ID
+    static void internNodes(const std::vector<Location>& coords, DhakaGraph& graph,
+                            std::vector<NodeId>& nodes) {
+        nodes.clear();
+        for (size_t i = 0; i < coords.size(); i++) {
+            nodes.push_back(graph.internNode(coords[i]));
+        }
+    }
+
+    static void internNodes(const Location* coords, size_t count, DhakaGraph& graph,
+                            std::vector<NodeId>& nodes) {
+        nodes.clear();
+        for (size_t i = 0; i < count; i++) {
+            nodes.push_back(graph.internNode(coords[i]));
+        }
+    }
+
+    static void parseRoadChunk(RoadChunk& chunk) {
+        std::vector<CSVField> fields;
+        const char* line = chunk.begin;
+        while (line < chunk.end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+            if (lineEnd == nullptr) lineEnd = chunk.end;
+            const char* next = lineEnd + (lineEnd < chunk.end ? 1 : 0);
+            if (lineEnd == line) {
+                line = next;
+                continue;
+            }
+
+            splitFields(line, lineEnd, fields);
+            line = next;
+            if (fields.size() < 3) continue;
+
+            size_t start = chunk.coords.size();
+            parseCoordinates(fields, chunk.coords);
+            double totalDistance;
+            if (chunk.coords.size() - start < 2 || !parseDouble(fields.back(), totalDistance)) {
+                chunk.coords.resize(start);
+                continue;
+            }
+            chunk.lineEnds.push_back(static_cast<uint32_t>(chunk.coords.size()));
+            chunk.distances.push_back(totalDistance);
+        }
+    }
+
+    // Splits [data, data + size) into up to `count` slices that each end
+    // just after a newline (or at the end of the file)
+    static std::vector<RoadChunk> splitChunks(const char* data, size_t size, size_t count) {
+        std::vector<RoadChunk> chunks;
+        const char* end = data + size;
+        const char* start = data;
+        for (size_t i = 1; i <= count && start < end; i++) {
+            const char* stop = (i == count) ? end : data + size / count * i;
+            if (stop < start) stop = start;
+            const char* newline = static_cast<const char*>(std::memchr(stop, '\n', end - stop));
+            stop = newline ? newline + 1 : end;
+            RoadChunk chunk;
+            chunk.begin = start;
+            chunk.end = stop;
+            chunks.push_back(chunk);
+            start = stop;
+        }
+        return chunks;
+    }
     
+    // Maps the file, parses newline-aligned slices in parallel, then interns
+    // and adds edges slice by slice in file order, so node IDs and edge order
+    // are exactly those of a sequential parse.
     static void parseRoadmap(const std::string& filename, DhakaGraph& graph) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+        MappedFile file;
+        if (!file.open(filename)) {
             std::cerr << "Error: Cannot open file " << filename << std::endl;
             return;
         }
+
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min(threads, std::max<size_t>(1, file.size() / MIN_CHUNK_BYTES));
+        std::vector<RoadChunk> chunks = splitChunks(file.data(), file.size(), threads);
+
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunks.size(); i++) {
+            workers.push_back(std::thread(parseRoadChunk, std::ref(chunks[i])));
+        }
+        parseRoadChunk(chunks[0]);
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+
+        size_t totalCoords = 0, totalEdges = 0;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            totalCoords += chunks[c].coords.size();
+            totalEdges += 2 * (chunks[c].coords.size() - chunks[c].lineEnds.size());
+        }
+        graph.reserve(totalCoords, totalEdges);
         
-        std::string line;
+        std::vector<NodeId> nodes;
         int edgeCount = 0;
-        
-        while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            
-            auto tokens = parseLine(line);
-            if (tokens.size() < 3) continue;
-            
-            // Parse coordinates
-            std::vector<Location> coords;
-            for (size_t i = 1; i + 1 < tokens.size() - 2; i += 2) {
-                try {
-                    double lon = std::stod(tokens[i]);
-                    double lat = std::stod(tokens[i + 1]);
-                    coords.push_back(Location(lat, lon));
-                } catch (...) {
-                    break;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const RoadChunk& chunk = chunks[c];
+            uint32_t lineStart = 0;
+            for (size_t l = 0; l < chunk.lineEnds.size(); l++) {
+                size_t count = chunk.lineEnds[l] - lineStart;
+                internNodes(&chunk.coords[lineStart], count, graph, nodes);
+                lineStart = chunk.lineEnds[l];
+
+                double segmentDist = chunk.distances[l] / (count - 1);
+                for (size_t i = 0; i + 1 < nodes.size(); i++) {
+                    graph.addEdge(nodes[i], nodes[i+1], segmentDist, TransportMode::CAR);
+                    graph.addEdge(nodes[i+1], nodes[i], segmentDist, TransportMode::CAR);
+                    edgeCount += 2;
                 }
             }
-            
-            if (coords.size() < 2) continue;
-            
-            
-            double totalDistance = 0.0;
-            try {
-                totalDistance = std::stod(tokens[tokens.size() - 1]);
-            } catch (...) {
-                continue;
-            }
-            
-            
-            double segmentDist = totalDistance / (coords.size() - 1);
-            for (size_t i = 0; i + 1 < coords.size(); i++) {
-                graph.addEdge(Edge(coords[i], coords[i+1], segmentDist, TransportMode::CAR));
-                graph.addEdge(Edge(coords[i+1], coords[i], segmentDist, TransportMode::CAR));
-                edgeCount += 2;
-            }
         }
         
-        file.close();
         std::cout << "  ✓ " << edgeCount << " road segments loaded" << std::endl;
     }
     
     static void parseTransitRoute(const std::string& filename, DhakaGraph& graph, 
                                   TransportMode mode) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
+        MappedFile file;
+        if (!file.open(filename)) {
             std::cerr << "Error: Cannot open file " << filename << std::endl;
             return;
         }
         
-        std::string line;
+        std::vector<CSVField> fields;
+        std::vector<Location> coords;
+        std::vector<NodeId> nodes;
         int edgeCount = 0;
         int stationCount = 0;
         
-        while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            
-            auto tokens = parseLine(line);
-            if (tokens.size() < 4) continue;
-            
-            
-            std::vector<Location> coords;
-            for (size_t i = 1; i + 1 < tokens.size() - 2; i += 2) {
-                try {
-                    double lon = std::stod(tokens[i]);
-                    double lat = std::stod(tokens[i + 1]);
-                    coords.push_back(Location(lat, lon));
-                } catch (...) {
-                    break;
-                }
+        const char* end = file.data() + file.size();
+        const char* line = file.data();
+        while (line < end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            if (lineEnd == nullptr) lineEnd = end;
+            const char* next = lineEnd + (lineEnd < end ? 1 : 0);
+            if (lineEnd == line) {
+                line = next;
+                continue;
             }
             
+            splitFields(line, lineEnd, fields);
+            line = next;
+            if (fields.size() < 4) continue;
+            
+            coords.clear();
+            parseCoordinates(fields, coords);
             if (coords.size() < 2) continue;
             
     
-            std::string startName = tokens[tokens.size() - 2];
-            std::string endName = tokens[tokens.size() - 1];
+            std::string startName = fields[fields.size() - 2].str();
+            std::string endName = fields[fields.size() - 1].str();
             
 
-            if (!coords.empty()) {
+            internNodes(coords, graph, nodes);
+
+            if (!nodes.empty()) {
                 if (mode == TransportMode::METRO) {
-                    graph.addMetroStation(coords.front(), startName);
-                    graph.addMetroStation(coords.back(), endName);
+                    graph.addMetroStation(nodes.front(), startName);
+                    graph.addMetroStation(nodes.back(), endName);
                 } else if (mode == TransportMode::BUS_BIKOLPO) {
-                    graph.addBikolpoStop(coords.front(), startName);
-                    graph.addBikolpoStop(coords.back(), endName);
+                    graph.addBikolpoStop(nodes.front(), startName);
+                    graph.addBikolpoStop(nodes.back(), endName);
                 } else if (mode == TransportMode::BUS_UTTARA) {
-                    graph.addUttaraStop(coords.front(), startName);
-                    graph.addUttaraStop(coords.back(), endName);
+                    graph.addUttaraStop(nodes.front(), startName);
+                    graph.addUttaraStop(nodes.back(), endName);
                 }
                 stationCount += 2;
             }
             
             
-            for (size_t i = 0; i + 1 < coords.size(); i++) {
+            for (size_t i = 0; i + 1 < nodes.size(); i++) {
                 double dist = haversineDistance(coords[i], coords[i+1]);
-                graph.addEdge(Edge(coords[i], coords[i+1], dist, mode));
-                graph.addEdge(Edge(coords[i+1], coords[i], dist, mode));
+                graph.addEdge(nodes[i], nodes[i+1], dist, mode);
+                graph.addEdge(nodes[i+1], nodes[i], dist, mode);
                 edgeCount += 2;
             }
         }
         
-        file.close();
-        
         std::string modeName = transportModeToString(mode);
         std::cout << "  ✓ " << edgeCount << " " << modeName << " segments loaded";
         if (stationCount > 0) {
@@ -146,17 +330,44 @@ public:
                           const std::string& metroFile,
                           const std::string& bikolpoFile,
                           const std::string& uttaraFile) {
+        ScopedPhase total("build_graph");
         std::cout << "Loading road network..." << std::endl;
-        parseRoadmap(roadmapFile, graph);
+        {
+            ScopedPhase phase("parse_roadmap");
+            parseRoadmap(roadmapFile, graph);
+        }
         
         std::cout << "Loading metro network..." << std::endl;
-        parseTransitRoute(metroFile, graph, TransportMode::METRO);
+        {
+            ScopedPhase phase("parse_metro");
+            parseTransitRoute(metroFile, graph, TransportMode::METRO);
+        }
         
         std::cout << "Loading Bikolpo bus network..." << std::endl;
-        parseTransitRoute(bikolpoFile, graph, TransportMode::BUS_BIKOLPO);
+        {
+            ScopedPhase phase("parse_bikolpo");
+            parseTransitRoute(bikolpoFile, graph, TransportMode::BUS_BIKOLPO);
+        }
         
         std::cout << "Loading Uttara bus network..." << std::endl;
-        parseTransitRoute(uttaraFile, graph, TransportMode::BUS_UTTARA);
+        {
+            ScopedPhase phase("parse_uttara");
+            parseTransitRoute(uttaraFile, graph, TransportMode::BUS_UTTARA);
+        }
+        
+        std::cout << "Linking stops to roads..." << std::endl;
+        size_t connectors;
+        {
+            ScopedPhase phase("link_transfers");
+            connectors = graph.linkTransfers(TRANSFER_RADIUS_KM, TRANSFER_ROAD_LINKS);
+        }
+        std::cout << "  ✓ " << connectors << " Walk connectors added" << std::endl;
+        
+        graph.freeze();
+
+        std::cout << "Folding degree-2 chains..." << std::endl;
+        size_t folded = graph.contractChains();
+        std::cout << "  ✓ " << folded << " shape points folded into chain edges" << std::endl;
     }
 };
 
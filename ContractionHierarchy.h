@@ -0,0 +1,476 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "SearchWorkspace.h"
+
+// Contraction Hierarchy over the single-mode subgraph of a DhakaGraph (the
+// car road network for Problem 1). Nodes are contracted in order of edge
+// difference plus contracted-neighbour count, with lazy priority updates
+// and settled-node-bounded witness searches. Every arc is either an original
+// graph edge or a shortcut over two child arcs, so query results unpack back
+// into the original Edge sequence.
+class ContractionHierarchy {
+private:
+    struct Arc {
+        NodeId from;
+        NodeId to;
+        double weight;
+        uint32_t child1;
+        uint32_t child2;
+        uint32_t graphEdge;
+    };
+
+    static const uint32_t NO_ARC = 0xFFFFFFFFu;
+    // Witness searches give up after this many settled nodes (and then add
+    // the shortcut anyway); priority simulation uses a cheaper limit.
+    static const uint32_t WITNESS_SETTLE_LIMIT = 200;
+    static const uint32_t SIMULATION_SETTLE_LIMIT = 20;
+
+    const DhakaGraph* graph;
+    TransportMode mode;
+    FlatArray<Arc> arcs;
+    FlatArray<uint32_t> rank;
+    FlatArray<NodeId> order;
+    size_t originalArcCount;
+
+    // Upward search graphs: forward arcs leave u towards higher-ranked
+    // nodes; backward arcs enter u from higher-ranked nodes.
+    FlatArray<uint32_t> forwardOffsets;
+    FlatArray<uint32_t> forwardArcs;
+    FlatArray<uint32_t> backwardOffsets;
+    FlatArray<uint32_t> backwardArcs;
+    std::shared_ptr<const void> backing;
+
+    // Contraction-time state
+    std::vector<std::vector<uint32_t>> outArcs;
+    std::vector<std::vector<uint32_t>> inArcs;
+    std::vector<uint8_t> contracted;
+    std::vector<uint32_t> deletedNeighbors;
+    SearchWorkspace witness;
+
+    uint32_t addArc(NodeId from, NodeId to, double weight, uint32_t child1, uint32_t child2,
+                    uint32_t graphEdge) {
+        Arc arc;
+        arc.from = from;
+        arc.to = to;
+        arc.weight = weight;
+        arc.child1 = child1;
+        arc.child2 = child2;
+        arc.graphEdge = graphEdge;
+        arcs.push_back(arc);
+        return static_cast<uint32_t>(arcs.size() - 1);
+    }
+
+    // Keeps only the cheapest arc per (from, to) pair among existing arcs
+    uint32_t findArc(NodeId from, NodeId to) const {
+        const std::vector<uint32_t>& list = outArcs[from];
+        for (size_t i = 0; i < list.size(); i++) {
+            if (arcs[list[i]].to == to) return list[i];
+        }
+        return NO_ARC;
+    }
+
+    // weights, if given, replace the graph's edge weights (infinity drops
+    // the edge)
+    void initializeArcs(const double* weights) {
+        size_t n = graph->getLocationCount();
+        outArcs.assign(n, std::vector<uint32_t>());
+        inArcs.assign(n, std::vector<uint32_t>());
+
+        for (NodeId u = 0; u < n; u++) {
+            for (uint32_t e = graph->edgeBegin(u); e < graph->edgeEnd(u); e++) {
+                if (graph->edgeMode(e) != mode) continue;
+                NodeId v = graph->edgeTarget(e);
+                double weight = weights != nullptr ? weights[e] : graph->edgeWeight(e);
+                if (v == u || std::isinf(weight)) continue;
+
+                uint32_t existing = findArc(u, v);
+                if (existing != NO_ARC) {
+                    if (weight < arcs[existing].weight) {
+                        arcs[existing].weight = weight;
+                        arcs[existing].graphEdge = e;
+                    }
+                    continue;
+                }
+                uint32_t id = addArc(u, v, weight, NO_ARC, NO_ARC, e);
+                outArcs[u].push_back(id);
+                inArcs[v].push_back(id);
+            }
+        }
+        originalArcCount = arcs.size();
+    }
+
+    // Bounded Dijkstra from `source` over uncontracted nodes, skipping `via`
+    void witnessSearch(NodeId source, NodeId via, double limit, uint32_t settleLimit) {
+        witness.reset(graph->getLocationCount());
+        witness.setSource(source);
+        uint32_t settledCount = 0;
+
+        while (!witness.empty() && witness.minKey() <= limit && settledCount < settleLimit) {
+            NodeId current = witness.settleNext();
+            settledCount++;
+            double currentCost = witness.distance(current);
+
+            const std::vector<uint32_t>& list = outArcs[current];
+            for (size_t i = 0; i < list.size(); i++) {
+                const Arc& arc = arcs[list[i]];
+                if (arc.to == via || contracted[arc.to]) continue;
+                witness.relax(arc.to, currentCost + arc.weight, current, list[i]);
+            }
+        }
+    }
+
+    // Visits every shortcut needed to contract v as (inArc, outArc) pairs
+    template <typename Visitor>
+    void forEachShortcut(NodeId v, Visitor& visit, uint32_t settleLimit) {
+        const std::vector<uint32_t>& ins = inArcs[v];
+        const std::vector<uint32_t>& outs = outArcs[v];
+        if (ins.empty() || outs.empty()) return;
+
+        double maxOut = 0.0;
+        for (size_t j = 0; j < outs.size(); j++) {
+            maxOut = std::max(maxOut, arcs[outs[j]].weight);
+        }
+
+        for (size_t i = 0; i < ins.size(); i++) {
+            const Arc& in = arcs[ins[i]];
+            NodeId u = in.from;
+            witnessSearch(u, v, in.weight + maxOut, settleLimit);
+
+            for (size_t j = 0; j < outs.size(); j++) {
+                const Arc& out = arcs[outs[j]];
+                if (out.to == u) continue;
+                if (witness.distance(out.to) <= in.weight + out.weight) continue;
+                visit(ins[i], outs[j]);
+            }
+        }
+    }
+
+    struct ShortcutCounter {
+        int count;
+        ShortcutCounter() : count(0) {}
+        void operator()(uint32_t, uint32_t) { count++; }
+    };
+
+    struct ShortcutCollector {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        void operator()(uint32_t in, uint32_t out) { pairs.push_back(std::make_pair(in, out)); }
+    };
+
+    int priority(NodeId v) {
+        ShortcutCounter counter;
+        forEachShortcut(v, counter, SIMULATION_SETTLE_LIMIT);
+        int removed = static_cast<int>(inArcs[v].size() + outArcs[v].size());
+        return counter.count - removed + static_cast<int>(deletedNeighbors[v]);
+    }
+
+    static void removeArcTo(std::vector<uint32_t>& list, const FlatArray<Arc>& arcs, NodeId node,
+                            bool matchTarget) {
+        size_t kept = 0;
+        for (size_t i = 0; i < list.size(); i++) {
+            NodeId other = matchTarget ? arcs[list[i]].to : arcs[list[i]].from;
+            if (other != node) list[kept++] = list[i];
+        }
+        list.resize(kept);
+    }
+
+    void contract(NodeId v) {
+        ShortcutCollector collector;
+        forEachShortcut(v, collector, WITNESS_SETTLE_LIMIT);
+
+        for (size_t i = 0; i < collector.pairs.size(); i++) {
+            const Arc in = arcs[collector.pairs[i].first];
+            const Arc out = arcs[collector.pairs[i].second];
+            double weight = in.weight + out.weight;
+
+            uint32_t existing = findArc(in.from, out.to);
+            if (existing != NO_ARC && arcs[existing].weight <= weight) continue;
+
+            uint32_t id = addArc(in.from, out.to, weight, collector.pairs[i].first,
+                                 collector.pairs[i].second, 0);
+            if (existing != NO_ARC) {
+                removeArcTo(outArcs[in.from], arcs, out.to, true);
+                removeArcTo(inArcs[out.to], arcs, in.from, false);
+            }
+            outArcs[in.from].push_back(id);
+            inArcs[out.to].push_back(id);
+        }
+
+        contracted[v] = 1;
+        for (size_t i = 0; i < inArcs[v].size(); i++) {
+            NodeId u = arcs[inArcs[v][i]].from;
+            removeArcTo(outArcs[u], arcs, v, true);
+            deletedNeighbors[u]++;
+        }
+        for (size_t i = 0; i < outArcs[v].size(); i++) {
+            NodeId w = arcs[outArcs[v][i]].to;
+            removeArcTo(inArcs[w], arcs, v, false);
+            deletedNeighbors[w]++;
+        }
+    }
+
+    void buildSearchGraph() {
+        size_t n = rank.size();
+        forwardOffsets.assign(n + 1, 0);
+        backwardOffsets.assign(n + 1, 0);
+
+        for (size_t a = 0; a < arcs.size(); a++) {
+            if (rank[arcs[a].from] < rank[arcs[a].to]) forwardOffsets[arcs[a].from + 1]++;
+            else backwardOffsets[arcs[a].to + 1]++;
+        }
+        for (size_t u = 0; u < n; u++) {
+            forwardOffsets[u + 1] += forwardOffsets[u];
+            backwardOffsets[u + 1] += backwardOffsets[u];
+        }
+
+        forwardArcs.resize(forwardOffsets[n]);
+        backwardArcs.resize(backwardOffsets[n]);
+        std::vector<uint32_t> forwardCursor(forwardOffsets.begin(), forwardOffsets.end() - 1);
+        std::vector<uint32_t> backwardCursor(backwardOffsets.begin(), backwardOffsets.end() - 1);
+        for (size_t a = 0; a < arcs.size(); a++) {
+            if (rank[arcs[a].from] < rank[arcs[a].to]) forwardArcs[forwardCursor[arcs[a].from]++] = a;
+            else backwardArcs[backwardCursor[arcs[a].to]++] = a;
+        }
+    }
+
+    void beginContraction(const DhakaGraph& g, TransportMode m, const double* weights) {
+        graph = &g;
+        mode = m;
+        arcs.clear();
+        size_t n = g.getLocationCount();
+
+        initializeArcs(weights);
+        contracted.assign(n, 0);
+        deletedNeighbors.assign(n, 0);
+        rank.assign(n, 0);
+        order.clear();
+        order.reserve(n);
+    }
+
+    void releaseContractionState() {
+        std::vector<std::vector<uint32_t>>().swap(outArcs);
+        std::vector<std::vector<uint32_t>>().swap(inArcs);
+        std::vector<uint8_t>().swap(contracted);
+        std::vector<uint32_t>().swap(deletedNeighbors);
+    }
+
+    void unpack(uint32_t arcId, std::vector<Edge>& path) const {
+        std::vector<uint32_t> stack(1, arcId);
+        while (!stack.empty()) {
+            const Arc& arc = arcs[stack.back()];
+            stack.pop_back();
+            if (arc.child1 == NO_ARC) {
+                graph->appendEdge(arc.from, arc.graphEdge, path);
+            } else {
+                stack.push_back(arc.child2);
+                stack.push_back(arc.child1);
+            }
+        }
+    }
+
+public:
+    ContractionHierarchy() : graph(nullptr), mode(TransportMode::CAR), originalArcCount(0) {}
+
+    void build(const DhakaGraph& g, TransportMode m) {
+        ScopedPhase phase("ch_build");
+        beginContraction(g, m, nullptr);
+        size_t n = g.getLocationCount();
+
+        typedef std::pair<int, NodeId> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        std::vector<int> current(n);
+        for (NodeId v = 0; v < n; v++) {
+            current[v] = priority(v);
+            queue.push(Entry(current[v], v));
+        }
+
+        while (!queue.empty()) {
+            Entry top = queue.top();
+            queue.pop();
+            NodeId v = top.second;
+            if (contracted[v] || top.first != current[v]) continue;
+
+            // Lazy update: re-evaluate and defer if no longer the minimum
+            current[v] = priority(v);
+            if (!queue.empty() && current[v] > queue.top().first) {
+                queue.push(Entry(current[v], v));
+                continue;
+            }
+
+            std::vector<NodeId> neighbors;
+            for (size_t i = 0; i < inArcs[v].size(); i++) neighbors.push_back(arcs[inArcs[v][i]].from);
+            for (size_t i = 0; i < outArcs[v].size(); i++) neighbors.push_back(arcs[outArcs[v][i]].to);
+
+            contract(v);
+            rank[v] = static_cast<uint32_t>(order.size());
+            order.push_back(v);
+
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+            for (size_t i = 0; i < neighbors.size(); i++) {
+                NodeId u = neighbors[i];
+                if (contracted[u]) continue;
+                current[u] = priority(u);
+                queue.push(Entry(current[u], u));
+            }
+        }
+
+        releaseContractionState();
+        buildSearchGraph();
+    }
+
+    // Re-contracts base's graph and mode in base's node order under new
+    // per-edge weights (indexed by graph edge; infinity removes the edge).
+    // Only the witness searches run again: no priorities, no lazy updates,
+    // which is most of what build() spends. The order stays good as long as
+    // the weights are a perturbation of the ones it was computed for.
+    void customize(const ContractionHierarchy& base, const double* weights) {
+        ScopedPhase phase("ch_customize");
+        beginContraction(*base.graph, base.mode, weights);
+        for (size_t i = 0; i < base.order.size(); i++) {
+            NodeId v = base.order[i];
+            contract(v);
+            rank[v] = static_cast<uint32_t>(order.size());
+            order.push_back(v);
+        }
+
+        releaseContractionState();
+        buildSearchGraph();
+    }
+
+    bool empty() const { return graph == nullptr; }
+    TransportMode getMode() const { return mode; }
+    size_t getShortcutCount() const { return arcs.size() - originalArcCount; }
+    const FlatArray<NodeId>& getOrder() const { return order; }
+
+    void saveSnapshot(SnapshotWriter& writer) const {
+        uint64_t params[2] = {static_cast<uint64_t>(mode), originalArcCount};
+        writer.addCopy("ch.params", std::vector<char>(reinterpret_cast<const char*>(params),
+                                                      reinterpret_cast<const char*>(params + 2)));
+        writer.addArray("ch.arcs", arcs);
+        writer.addArray("ch.rank", rank);
+        writer.addArray("ch.order", order);
+        writer.addArray("ch.forwardOffsets", forwardOffsets);
+        writer.addArray("ch.forwardArcs", forwardArcs);
+        writer.addArray("ch.backwardOffsets", backwardOffsets);
+        writer.addArray("ch.backwardArcs", backwardArcs);
+    }
+
+    // g must be the graph the snapshot was taken from (usually loaded from
+    // the same file)
+    bool loadSnapshot(const SnapshotReader& reader, const DhakaGraph& g) {
+        const char* data;
+        size_t size;
+        if (!reader.getBytes("ch.params", data, size) || size != 2 * sizeof(uint64_t) ||
+            !reader.getArray("ch.arcs", arcs) ||
+            !reader.getArray("ch.rank", rank) ||
+            !reader.getArray("ch.order", order) ||
+            !reader.getArray("ch.forwardOffsets", forwardOffsets) ||
+            !reader.getArray("ch.forwardArcs", forwardArcs) ||
+            !reader.getArray("ch.backwardOffsets", backwardOffsets) ||
+            !reader.getArray("ch.backwardArcs", backwardArcs)) return false;
+        if (rank.size() != g.getLocationCount()) {
+            std::cerr << "Error: Snapshot hierarchy does not match the graph" << std::endl;
+            return false;
+        }
+
+        uint64_t params[2];
+        std::memcpy(params, data, sizeof(params));
+        graph = &g;
+        mode = static_cast<TransportMode>(params[0]);
+        originalArcCount = static_cast<size_t>(params[1]);
+        backing = reader.mapping();
+        return true;
+    }
+
+    // Full upward search from start, over forward arcs or (forward = false)
+    // backward arcs, calling visit(node, distance) for each settled node.
+    // The building block of bucket-based many-to-many queries.
+    template <typename Visitor>
+    void upwardSearch(NodeId start, bool forward, SearchWorkspace& ws, Visitor& visit) const {
+        ws.reset(rank.size());
+        if (empty() || start == INVALID_NODE) return;
+        ws.setSource(start);
+
+        const FlatArray<uint32_t>& offsets = forward ? forwardOffsets : backwardOffsets;
+        const FlatArray<uint32_t>& list = forward ? forwardArcs : backwardArcs;
+        while (!ws.empty()) {
+            NodeId current = ws.settleNext();
+            double currentCost = ws.distance(current);
+            visit(current, currentCost);
+
+            for (uint32_t i = offsets[current]; i < offsets[current + 1]; i++) {
+                const Arc& arc = arcs[list[i]];
+                ws.relax(forward ? arc.to : arc.from, currentCost + arc.weight, current, list[i]);
+            }
+        }
+    }
+
+    // Upward/downward bidirectional search; returns the unpacked path from
+    // source to destination over original graph edges.
+    std::vector<Edge> query(NodeId source, NodeId destination,
+                            SearchWorkspace& forward, SearchWorkspace& backward,
+                            size_t& settledNodes) const {
+        settledNodes = 0;
+        std::vector<Edge> path;
+        if (empty() || source == INVALID_NODE || destination == INVALID_NODE) return path;
+        if (source == destination) return path;
+
+        size_t n = rank.size();
+        forward.reset(n);
+        backward.reset(n);
+        forward.setSource(source);
+        backward.setSource(destination);
+
+        double best = std::numeric_limits<double>::infinity();
+        NodeId meet = INVALID_NODE;
+        bool forwardTurn = true;
+
+        while (true) {
+            bool forwardActive = !forward.empty() && forward.minKey() < best;
+            bool backwardActive = !backward.empty() && backward.minKey() < best;
+            if (!forwardActive && !backwardActive) break;
+
+            bool goForward = forwardActive && (forwardTurn || !backwardActive);
+            forwardTurn = !forwardTurn;
+
+            SearchWorkspace& side = goForward ? forward : backward;
+            SearchWorkspace& other = goForward ? backward : forward;
+            const FlatArray<uint32_t>& offsets = goForward ? forwardOffsets : backwardOffsets;
+            const FlatArray<uint32_t>& list = goForward ? forwardArcs : backwardArcs;
+
+            NodeId current = side.settleNext();
+            settledNodes++;
+            double currentCost = side.distance(current);
+
+            if (other.reached(current) && currentCost + other.distance(current) < best) {
+                best = currentCost + other.distance(current);
+                meet = current;
+            }
+
+            for (uint32_t i = offsets[current]; i < offsets[current + 1]; i++) {
+                const Arc& arc = arcs[list[i]];
+                NodeId next = goForward ? arc.to : arc.from;
+                side.relax(next, currentCost + arc.weight, current, list[i]);
+            }
+        }
+
+        if (meet == INVALID_NODE) return path;
+
+        std::vector<uint32_t> upArcs;
+        for (NodeId current = meet; current != source; current = forward.parentOf(current)) {
+            upArcs.push_back(forward.parentEdgeOf(current));
+        }
+        for (size_t i = upArcs.size(); i-- > 0;) {
+            unpack(upArcs[i], path);
+        }
+        for (NodeId current = meet; current != destination; current = backward.parentOf(current)) {
+            unpack(backward.parentEdgeOf(current), path);
+        }
+        return path;
+    }
+};
+
+#endif // CONTRACTION_HIERARCHY_H
@@ -0,0 +1,84 @@
+#ifndef COST_MODELS_H
+#define COST_MODELS_H
+
+#include "DhakaRouting.h"
+
+const double CAR_COST_PER_KM = 20.0;
+const double METRO_COST_PER_KM = 5.0;
+const double BUS_COST_PER_KM = 7.0;
+
+typedef uint8_t ModeMask;
+
+constexpr ModeMask modeBit(TransportMode mode) {
+    return static_cast<ModeMask>(1u << static_cast<unsigned>(mode));
+}
+
+constexpr bool modeAllowed(ModeMask mask, TransportMode mode) {
+    return (mask & modeBit(mode)) != 0;
+}
+
+// Cost policies for AllProblemsSolver's search kernels. Each one fixes the
+// allowed modes as a compile-time mask and prices an edge as
+// distance * ratePerKm(mode), so the relaxation loop inlines completely.
+// accessCost prices the off-network walk to and from the snapped nodes.
+// pricesCongestion says whether live traffic slowdowns count against an
+// edge (see LiveTraffic); closures always do.
+
+// PROBLEM 1: car distance in km
+struct CarDistanceCost {
+    static const ModeMask allowedModes = modeBit(TransportMode::CAR);
+    static const bool pricesCongestion = true;
+
+    static double ratePerKm(TransportMode mode) {
+        return mode == TransportMode::CAR ? 1.0 : 0.0;
+    }
+
+    static double cost(double distance, TransportMode mode) {
+        return distance * ratePerKm(mode);
+    }
+
+    static double accessCost(double walkKm) { return walkKm; }
+};
+
+// PROBLEM 2: fare in Tk over car and metro
+struct CarMetroFareCost {
+    static const ModeMask allowedModes = modeBit(TransportMode::CAR) | modeBit(TransportMode::METRO);
+    static const bool pricesCongestion = false;
+
+    static double ratePerKm(TransportMode mode) {
+        if (mode == TransportMode::CAR) return CAR_COST_PER_KM;
+        if (mode == TransportMode::METRO) return METRO_COST_PER_KM;
+        return 0.0;
+    }
+
+    static double cost(double distance, TransportMode mode) {
+        return distance * ratePerKm(mode);
+    }
+
+    static double accessCost(double) { return 0.0; }
+};
+
+// PROBLEM 3: fare in Tk over every vehicle mode, plus the WALK connectors
+// between stops and roads, which are free
+struct AllModesFareCost {
+    static const ModeMask allowedModes = modeBit(TransportMode::CAR) | modeBit(TransportMode::METRO) |
+                                         modeBit(TransportMode::BUS_BIKOLPO) |
+                                         modeBit(TransportMode::BUS_UTTARA) | modeBit(TransportMode::WALK);
+    static const bool pricesCongestion = false;
+
+    static double ratePerKm(TransportMode mode) {
+        if (mode == TransportMode::CAR) return CAR_COST_PER_KM;
+        if (mode == TransportMode::METRO) return METRO_COST_PER_KM;
+        if (mode == TransportMode::BUS_BIKOLPO || mode == TransportMode::BUS_UTTARA)
+            return BUS_COST_PER_KM;
+        return 0.0;
+    }
+
+    static double cost(double distance, TransportMode mode) {
+        return distance * ratePerKm(mode);
+    }
+
+    static double accessCost(double) { return 0.0; }
+};
+
+#endif // COST_MODELS_H
@@ -2,86 +2,696 @@
 #define DHAKA_GRAPH_H
 
 #include "DhakaRouting.h"
+#include "NodeInterner.h"
+#include "SpatialIndex.h"
+#include "Instrumentation.h"
 
 
 class DhakaGraph {
 private:
-    std::map<Location, std::vector<Edge>> adjacencyList;
-    std::set<Location> locations;
-    std::map<Location, std::string> metroStations;
-    std::map<Location, std::string> bikolpoStops;
-    std::map<Location, std::string> uttaraStops;
-    
+    NodeInterner interner;
+
+    // Build-time edge list, released by freeze()
+    std::vector<NodeId> buildFrom;
+    std::vector<NodeId> buildTo;
+    std::vector<double> buildWeights;
+    std::vector<TransportMode> buildModes;
+
+    std::unordered_map<NodeId, std::string> metroStations;
+    std::unordered_map<NodeId, std::string> bikolpoStops;
+    std::unordered_map<NodeId, std::string> uttaraStops;
+
+    // Every distinct station name once, and the name ID of each named node
+    // (metro names win over Bikolpo, Bikolpo over Uttara), so a lookup is
+    // one hash probe and results can carry 4-byte IDs instead of strings
+    std::vector<std::string> stationNames;
+    std::unordered_map<NodeId, uint32_t> stationNameIds;
+
+    // Frozen compressed-sparse-row graph: the outgoing edges of node u are
+    // edgeTargets/edgeWeights/edgeModes[edgeOffsets[u] .. edgeOffsets[u+1])
+    FlatArray<double> nodeLat;
+    FlatArray<double> nodeLon;
+    FlatArray<uint32_t> edgeOffsets;
+    FlatArray<NodeId> edgeTargets;
+    FlatArray<double> edgeWeights;
+    FlatArray<TransportMode> edgeModes;
+
+    // Reverse CSR: the incoming edges of v are the forward edges
+    // inEdgeIds[inOffsets[v] .. inOffsets[v+1]), whose sources are inSources
+    FlatArray<uint32_t> inOffsets;
+    FlatArray<NodeId> inSources;
+    FlatArray<uint32_t> inEdgeIds;
+
+    // Shape table filled by contractChains(): the original segments of chain
+    // edge e, in travel order, end at shapeTargets[shapeOffsets[e] ..
+    // shapeOffsets[e+1]) and weigh shapeWeights[same range]. Plain edges
+    // have an empty range; the arrays are empty if nothing was contracted.
+    FlatArray<uint32_t> shapeOffsets;
+    FlatArray<NodeId> shapeTargets;
+    FlatArray<double> shapeWeights;
+    // One chain edge through each folded shape point, NO_EDGE elsewhere
+    FlatArray<uint32_t> shapeEdgeOf;
+
+    SpatialIndex spatialIndex;
+    double minWeightRatio[MODE_COUNT];
+    bool frozen;
+
+    // Keeps a loaded snapshot mapped while the arrays above view it
+    std::shared_ptr<const void> backing;
+
+    // Station names as (kind, node, length, bytes) records, so the three
+    // maps round-trip through a single snapshot section
+    static void appendStations(std::vector<char>& out, uint8_t kind,
+                               const std::unordered_map<NodeId, std::string>& stations) {
+        for (const auto& entry : stations) {
+            uint32_t length = static_cast<uint32_t>(entry.second.size());
+            out.push_back(static_cast<char>(kind));
+            out.insert(out.end(), reinterpret_cast<const char*>(&entry.first),
+                       reinterpret_cast<const char*>(&entry.first) + sizeof(NodeId));
+            out.insert(out.end(), reinterpret_cast<const char*>(&length),
+                       reinterpret_cast<const char*>(&length) + sizeof(length));
+            out.insert(out.end(), entry.second.begin(), entry.second.end());
+        }
+    }
+
+    bool readStations(const char* data, size_t size) {
+        const size_t recordHeader = 1 + sizeof(NodeId) + sizeof(uint32_t);
+        size_t pos = 0;
+        while (pos + recordHeader <= size) {
+            uint8_t kind = static_cast<uint8_t>(data[pos]);
+            NodeId node;
+            uint32_t length;
+            std::memcpy(&node, data + pos + 1, sizeof(node));
+            std::memcpy(&length, data + pos + 1 + sizeof(node), sizeof(length));
+            pos += recordHeader;
+            if (pos + length > size || kind > 2) return false;
+            std::string name(data + pos, length);
+            pos += length;
+            if (kind == 0) metroStations[node] = name;
+            else if (kind == 1) bikolpoStops[node] = name;
+            else uttaraStops[node] = name;
+        }
+        return pos == size;
+    }
+
+    void indexStationNames() {
+        stationNames.clear();
+        stationNameIds.clear();
+        std::unordered_map<std::string, uint32_t> interned;
+        const std::unordered_map<NodeId, std::string>* kinds[] = {&metroStations, &bikolpoStops, &uttaraStops};
+        for (size_t k = 0; k < 3; k++) {
+            for (const auto& entry : *kinds[k]) {
+                if (stationNameIds.count(entry.first)) continue;
+                auto it = interned.find(entry.second);
+                if (it == interned.end()) {
+                    it = interned.insert(std::make_pair(entry.second, static_cast<uint32_t>(stationNames.size()))).first;
+                    stationNames.push_back(entry.second);
+                }
+                stationNameIds[entry.first] = it->second;
+            }
+        }
+    }
+
+    void buildReverseIndex() {
+        size_t n = nodeLat.size();
+        size_t m = edgeTargets.size();
+
+        inOffsets.assign(n + 1, 0);
+        for (size_t e = 0; e < m; e++) {
+            inOffsets[edgeTargets[e] + 1]++;
+        }
+        for (size_t v = 0; v < n; v++) {
+            inOffsets[v + 1] += inOffsets[v];
+        }
+
+        inSources.resize(m);
+        inEdgeIds.resize(m);
+        std::vector<uint32_t> cursor(inOffsets.begin(), inOffsets.end() - 1);
+        for (NodeId u = 0; u < n; u++) {
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                uint32_t slot = cursor[edgeTargets[e]]++;
+                inSources[slot] = u;
+                inEdgeIds[slot] = e;
+            }
+        }
+    }
+
+    // For each mode, the smallest ratio of edge weight to the straight-line
+    // distance between its endpoints. Road weights come from the CSV length
+    // column, so this can be well below 1; goal-directed searches scale
+    // their haversine bound by it to stay admissible.
+    void computeWeightRatios() {
+        for (int i = 0; i < MODE_COUNT; i++) {
+            minWeightRatio[i] = std::numeric_limits<double>::infinity();
+        }
+        for (NodeId u = 0; u < nodeLat.size(); u++) {
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                double straight = spatialIndex.distanceBetween(u, edgeTargets[e]);
+                if (straight <= 0) continue;
+                double& ratio = minWeightRatio[static_cast<int>(edgeModes[e])];
+                ratio = std::min(ratio, edgeWeights[e] / straight);
+            }
+        }
+    }
+
+    // x can be folded into a chain if its only neighbours are two distinct
+    // nodes and it passes traffic straight through, in one mode: in = out = 1
+    // (one-way) or in = out = 2 with the same two neighbours both ways
+    bool isFoldable(NodeId x) const {
+        uint32_t out = edgeOffsets[x + 1] - edgeOffsets[x];
+        uint32_t in = inOffsets[x + 1] - inOffsets[x];
+        if (out != in || (out != 1 && out != 2) || stationNameIds.count(x)) return false;
+
+        TransportMode mode = edgeModes[edgeOffsets[x]];
+        NodeId outs[2], ins[2];
+        for (uint32_t i = 0; i < out; i++) {
+            uint32_t e = edgeOffsets[x] + i;
+            uint32_t r = inOffsets[x] + i;
+            if (edgeModes[e] != mode || edgeModes[inEdgeIds[r]] != mode) return false;
+            outs[i] = edgeTargets[e];
+            ins[i] = inSources[r];
+            if (outs[i] == x || ins[i] == x) return false;
+        }
+        if (out == 1) return outs[0] != ins[0];
+        return outs[0] != outs[1] && ((ins[0] == outs[0] && ins[1] == outs[1]) ||
+                                      (ins[0] == outs[1] && ins[1] == outs[0]));
+    }
+
+    // The edge leaving folded node x that does not lead back to `from`
+    uint32_t passThrough(NodeId from, NodeId x) const {
+        uint32_t e = edgeOffsets[x];
+        if (edgeOffsets[x + 1] - e == 2 && edgeTargets[e] == from) e++;
+        return e;
+    }
+
+    bool hasShape(uint32_t e) const {
+        return !shapeOffsets.empty() && shapeOffsets[e] != shapeOffsets[e + 1];
+    }
+
+    // Source node of edge e (a binary search over the CSR offsets)
+    NodeId edgeSource(uint32_t e) const {
+        const uint32_t* it = std::upper_bound(edgeOffsets.begin(), edgeOffsets.end(), e);
+        return static_cast<NodeId>(it - edgeOffsets.begin() - 1);
+    }
+
+    // Where segment from -> to lies in edge e: its shape table index,
+    // WHOLE_EDGE if e is that plain segment, NO_SEGMENT if e misses it
+    uint32_t findSegment(uint32_t e, NodeId from, NodeId to) const {
+        if (!hasShape(e)) return edgeSource(e) == from && edgeTargets[e] == to ? WHOLE_EDGE : NO_SEGMENT;
+        NodeId start = edgeSource(e);
+        for (uint32_t i = shapeOffsets[e]; i < shapeOffsets[e + 1]; i++) {
+            if (start == from && shapeTargets[i] == to) return i;
+            start = shapeTargets[i];
+        }
+        return NO_SEGMENT;
+    }
+
 public:
+    static const uint32_t NO_EDGE = 0xFFFFFFFFu;
+    static const uint32_t NO_SEGMENT = 0xFFFFFFFFu;
+    static const uint32_t WHOLE_EDGE = 0xFFFFFFFEu;
+
+    DhakaGraph() : frozen(false) {
+        for (int i = 0; i < MODE_COUNT; i++) {
+            minWeightRatio[i] = 0.0;
+        }
+    }
+
+    // Pre-sizes the build buffers; nodes may be an upper bound
+    void reserve(size_t nodes, size_t edges) {
+        interner.reserve(nodes);
+        nodeLat.reserve(nodes);
+        nodeLon.reserve(nodes);
+        buildFrom.reserve(buildFrom.size() + edges);
+        buildTo.reserve(buildTo.size() + edges);
+        buildWeights.reserve(buildWeights.size() + edges);
+        buildModes.reserve(buildModes.size() + edges);
+    }
+
+    // Returns the stable ID of the node at this (quantized) coordinate,
+    // creating it on first sight. Only valid before freeze().
+    NodeId internNode(const Location& loc) {
+        bool inserted = false;
+        NodeId id = interner.intern(loc, static_cast<NodeId>(nodeLat.size()), inserted);
+        if (inserted) {
+            nodeLat.push_back(loc.lat);
+            nodeLon.push_back(loc.lon);
+        }
+        return id;
+    }
+
+    // Only valid before freeze()
+    void addEdge(NodeId from, NodeId to, double distance, TransportMode mode) {
+        buildFrom.push_back(from);
+        buildTo.push_back(to);
+        buildWeights.push_back(distance);
+        buildModes.push_back(mode);
+    }
+
     void addEdge(const Edge& edge) {
-        locations.insert(edge.start);
-        locations.insert(edge.end);
-        adjacencyList[edge.start].push_back(edge);
+        NodeId from = internNode(edge.start);
+        NodeId to = internNode(edge.end);
+        addEdge(from, to, edge.distance, edge.mode);
+    }
+
+    // Adds WALK connectors before freeze(). A station or stop with no road
+    // edge is linked to its nearest road nodes within radiusKm (at most
+    // roadLinks of them), and stations or stops within radiusKm whose nodes
+    // share no transit mode are linked to each other for transfers; linking
+    // stops of one line would only let free walks shortcut it. Connectors
+    // run both ways and weigh their straight-line length; returns how many
+    // edges were added.
+    size_t linkTransfers(double radiusKm, size_t roadLinks) {
+        const uint8_t roadBit = static_cast<uint8_t>(1u << static_cast<unsigned>(TransportMode::CAR));
+
+        // Modes of the edges leaving or entering each node, one bit per mode
+        std::vector<uint8_t> nodeModes(nodeLat.size(), 0);
+        for (size_t i = 0; i < buildFrom.size(); i++) {
+            uint8_t bit = static_cast<uint8_t>(1u << static_cast<unsigned>(buildModes[i]));
+            nodeModes[buildFrom[i]] |= bit;
+            nodeModes[buildTo[i]] |= bit;
+        }
+
+        std::vector<uint8_t> isStop(nodeLat.size(), 0);
+        std::vector<NodeId> stops;
+        const std::unordered_map<NodeId, std::string>* kinds[] = {&metroStations, &bikolpoStops, &uttaraStops};
+        for (size_t k = 0; k < 3; k++) {
+            for (const auto& entry : *kinds[k]) {
+                if (isStop[entry.first]) continue;
+                isStop[entry.first] = 1;
+                stops.push_back(entry.first);
+            }
+        }
+        std::sort(stops.begin(), stops.end());
+
+        // Build-time index over every node; freeze() builds the real one
+        SpatialIndex index;
+        index.build(nodeLat, nodeLon);
+
+        size_t added = 0;
+        for (size_t s = 0; s < stops.size(); s++) {
+            NodeId stop = stops[s];
+            Location here = getLocation(stop);
+            std::vector<NodeId> nearby = index.withinRadius(here, radiusKm);
+            size_t roadLinked = 0;
+            for (size_t i = 0; i < nearby.size(); i++) {
+                NodeId other = nearby[i];
+                if (other == stop) continue;
+                bool linkRoad = !(nodeModes[stop] & roadBit) && (nodeModes[other] & roadBit) &&
+                                roadLinked < roadLinks;
+                bool linkStop = isStop[other] && other > stop &&
+                                (nodeModes[other] & nodeModes[stop] & ~roadBit) == 0;
+                if (!linkRoad && !linkStop) continue;
+                if (linkRoad) roadLinked++;
+
+                double distance = index.distanceBetween(stop, other);
+                addEdge(stop, other, distance, TransportMode::WALK);
+                addEdge(other, stop, distance, TransportMode::WALK);
+                added += 2;
+            }
+        }
+        return added;
+    }
+
+    // Packs the edge list into CSR arrays (a stable counting sort by source,
+    // so each node keeps its edges in insertion order) and releases the
+    // build-time buffers.
+    void freeze() {
+        if (frozen) return;
+        ScopedPhase phase("freeze");
+
+        size_t n = nodeLat.size();
+        size_t m = buildFrom.size();
+
+        edgeOffsets.assign(n + 1, 0);
+        for (size_t i = 0; i < m; i++) {
+            edgeOffsets[buildFrom[i] + 1]++;
+        }
+        for (size_t u = 0; u < n; u++) {
+            edgeOffsets[u + 1] += edgeOffsets[u];
+        }
+
+        edgeTargets.resize(m);
+        edgeWeights.resize(m);
+        edgeModes.resize(m);
+        std::vector<uint32_t> cursor(edgeOffsets.begin(), edgeOffsets.end() - 1);
+        for (size_t i = 0; i < m; i++) {
+            uint32_t slot = cursor[buildFrom[i]]++;
+            edgeTargets[slot] = buildTo[i];
+            edgeWeights[slot] = buildWeights[i];
+            edgeModes[slot] = buildModes[i];
+        }
+
+        std::vector<NodeId>().swap(buildFrom);
+        std::vector<NodeId>().swap(buildTo);
+        std::vector<double>().swap(buildWeights);
+        std::vector<TransportMode>().swap(buildModes);
+
+        buildReverseIndex();
+        spatialIndex.build(nodeLat, nodeLon);
+        computeWeightRatios();
+        indexStationNames();
+        frozen = true;
     }
-    
-    const std::vector<Edge>& getNeighbors(const Location& loc) const {
-        static const std::vector<Edge> empty;
-        auto it = adjacencyList.find(loc);
-        return (it != adjacencyList.end()) ? it->second : empty;
+
+    bool isFrozen() const { return frozen; }
+
+    // Post-load simplification: folds every maximal chain of degree-2 shape
+    // points (see isFoldable) into one edge per direction, with the summed
+    // weight and the chain's mode. The points and per-segment weights move
+    // to the shape table, so appendEdge() still yields the full geometry.
+    // Stations and stops are never folded, and a chain closing on itself
+    // keeps one node. Folded nodes keep their IDs and coordinates (findNode
+    // still resolves them) but have no edges and are left out of the
+    // spatial index, so queries snap to the nearest routable node. Edge IDs
+    // change; call it before building anything keyed by them. Returns how
+    // many nodes were folded.
+    size_t contractChains() {
+        if (!frozen || !shapeEdgeOf.empty()) return 0;
+        ScopedPhase phase("contract_chains");
+        size_t n = nodeLat.size();
+
+        std::vector<uint8_t> folded(n, 0);
+        for (NodeId x = 0; x < n; x++) folded[x] = isFoldable(x);
+
+        // Walk each chain forward from one of its nodes; coming back to the
+        // start means a loop with no end node, so the start stays
+        std::vector<uint8_t> seen(n, 0);
+        for (NodeId x = 0; x < n; x++) {
+            if (!folded[x] || seen[x]) continue;
+            seen[x] = 1;
+            NodeId prev = x;
+            NodeId current = edgeTargets[edgeOffsets[x]];
+            while (folded[current] && current != x && !seen[current]) {
+                seen[current] = 1;
+                uint32_t e = passThrough(prev, current);
+                prev = current;
+                current = edgeTargets[e];
+            }
+            if (current == x) folded[x] = 0;
+        }
+
+        std::vector<uint32_t> offsets(n + 1, 0);
+        std::vector<NodeId> targets;
+        std::vector<double> weights;
+        std::vector<TransportMode> modes;
+        std::vector<uint32_t> shapeOffs(1, 0);
+        std::vector<NodeId> shapeNodes;
+        std::vector<double> shapeW;
+        std::vector<uint32_t> shapeEdge(n, NO_EDGE);
+        size_t foldedCount = 0;
+        for (NodeId u = 0; u < n; u++) {
+            offsets[u] = static_cast<uint32_t>(targets.size());
+            if (folded[u]) {
+                foldedCount++;
+                continue;
+            }
+            for (uint32_t e = edgeOffsets[u]; e < edgeOffsets[u + 1]; e++) {
+                uint32_t id = static_cast<uint32_t>(targets.size());
+                NodeId v = edgeTargets[e];
+                double weight = edgeWeights[e];
+                if (folded[v]) {
+                    shapeNodes.push_back(v);
+                    shapeW.push_back(edgeWeights[e]);
+                    NodeId prev = u;
+                    while (folded[v]) {
+                        if (shapeEdge[v] == NO_EDGE) shapeEdge[v] = id;
+                        uint32_t next = passThrough(prev, v);
+                        prev = v;
+                        v = edgeTargets[next];
+                        weight += edgeWeights[next];
+                        shapeNodes.push_back(v);
+                        shapeW.push_back(edgeWeights[next]);
+                    }
+                }
+                targets.push_back(v);
+                weights.push_back(weight);
+                modes.push_back(edgeModes[e]);
+                shapeOffs.push_back(static_cast<uint32_t>(shapeNodes.size()));
+            }
+        }
+        offsets[n] = static_cast<uint32_t>(targets.size());
+
+        edgeOffsets.adopt(offsets);
+        edgeTargets.adopt(targets);
+        edgeWeights.adopt(weights);
+        edgeModes.adopt(modes);
+        shapeOffsets.adopt(shapeOffs);
+        shapeTargets.adopt(shapeNodes);
+        shapeWeights.adopt(shapeW);
+        shapeEdgeOf.adopt(shapeEdge);
+
+        buildReverseIndex();
+        spatialIndex.build(nodeLat, nodeLon, 2.0, &folded);
+        computeWeightRatios();
+        return foldedCount;
+    }
+
+    size_t getShapePointCount() const { return shapeTargets.size(); }
+
+    // Adds every frozen array to the writer; the graph must outlive write()
+    void saveSnapshot(SnapshotWriter& writer) const {
+        interner.saveSnapshot(writer);
+        writer.addArray("graph.nodeLat", nodeLat);
+        writer.addArray("graph.nodeLon", nodeLon);
+        writer.addArray("graph.edgeOffsets", edgeOffsets);
+        writer.addArray("graph.edgeTargets", edgeTargets);
+        writer.addArray("graph.edgeWeights", edgeWeights);
+        writer.addArray("graph.edgeModes", edgeModes);
+        writer.addArray("graph.inOffsets", inOffsets);
+        writer.addArray("graph.inSources", inSources);
+        writer.addArray("graph.inEdgeIds", inEdgeIds);
+        writer.addArray("graph.shapeOffsets", shapeOffsets);
+        writer.addArray("graph.shapeTargets", shapeTargets);
+        writer.addArray("graph.shapeWeights", shapeWeights);
+        writer.addArray("graph.shapeEdgeOf", shapeEdgeOf);
+        writer.add("graph.minWeightRatio", minWeightRatio, sizeof(minWeightRatio));
+        spatialIndex.saveSnapshot(writer);
+
+        std::vector<char> stations;
+        appendStations(stations, 0, metroStations);
+        appendStations(stations, 1, bikolpoStops);
+        appendStations(stations, 2, uttaraStops);
+        writer.addCopy("graph.stations", stations);
+    }
+
+    // Replaces this (unbuilt) graph with views into the snapshot; nothing is
+    // copied except the station names
+    bool loadSnapshot(const SnapshotReader& reader) {
+        ScopedPhase phase("snapshot_load");
+        const char* data;
+        size_t size;
+        if (!interner.loadSnapshot(reader) ||
+            !reader.getArray("graph.nodeLat", nodeLat) ||
+            !reader.getArray("graph.nodeLon", nodeLon) ||
+            !reader.getArray("graph.edgeOffsets", edgeOffsets) ||
+            !reader.getArray("graph.edgeTargets", edgeTargets) ||
+            !reader.getArray("graph.edgeWeights", edgeWeights) ||
+            !reader.getArray("graph.edgeModes", edgeModes) ||
+            !reader.getArray("graph.inOffsets", inOffsets) ||
+            !reader.getArray("graph.inSources", inSources) ||
+            !reader.getArray("graph.inEdgeIds", inEdgeIds) ||
+            !reader.getArray("graph.shapeOffsets", shapeOffsets) ||
+            !reader.getArray("graph.shapeTargets", shapeTargets) ||
+            !reader.getArray("graph.shapeWeights", shapeWeights) ||
+            !reader.getArray("graph.shapeEdgeOf", shapeEdgeOf) ||
+            !reader.getBytes("graph.minWeightRatio", data, size) || size != sizeof(minWeightRatio) ||
+            !spatialIndex.loadSnapshot(reader)) return false;
+        std::memcpy(minWeightRatio, data, sizeof(minWeightRatio));
+
+        size_t n = nodeLat.size();
+        size_t m = edgeTargets.size();
+        if (nodeLon.size() != n || edgeOffsets.size() != n + 1 || inOffsets.size() != n + 1 ||
+            edgeWeights.size() != m || edgeModes.size() != m || inSources.size() != m ||
+            inEdgeIds.size() != m || edgeOffsets[n] != m ||
+            (!shapeOffsets.empty() && (shapeOffsets.size() != m + 1 || shapeOffsets[m] != shapeTargets.size() ||
+                                       shapeWeights.size() != shapeTargets.size() || shapeEdgeOf.size() != n))) {
+            std::cerr << "Error: Snapshot arrays are inconsistent" << std::endl;
+            return false;
+        }
+
+        if (!reader.getBytes("graph.stations", data, size) || !readStations(data, size)) return false;
+        indexStationNames();
+
+        buildFrom.clear();
+        buildTo.clear();
+        buildWeights.clear();
+        buildModes.clear();
+        backing = reader.mapping();
+        frozen = true;
+        return true;
+    }
+
+    NodeId findNode(const Location& loc) const {
+        return interner.find(loc);
+    }
+
+    Location getLocation(NodeId node) const {
+        return Location(nodeLat[node], nodeLon[node]);
+    }
+
+    const FlatArray<double>& getLatitudes() const { return nodeLat; }
+    const FlatArray<double>& getLongitudes() const { return nodeLon; }
+
+    uint32_t edgeBegin(NodeId node) const { return edgeOffsets[node]; }
+    uint32_t edgeEnd(NodeId node) const { return edgeOffsets[node + 1]; }
+    NodeId edgeTarget(uint32_t e) const { return edgeTargets[e]; }
+    double edgeWeight(uint32_t e) const { return edgeWeights[e]; }
+    TransportMode edgeMode(uint32_t e) const { return edgeModes[e]; }
+
+    uint32_t inEdgeBegin(NodeId node) const { return inOffsets[node]; }
+    uint32_t inEdgeEnd(NodeId node) const { return inOffsets[node + 1]; }
+    NodeId inEdgeSource(uint32_t i) const { return inSources[i]; }
+    uint32_t inEdgeId(uint32_t i) const { return inEdgeIds[i]; }
+
+    double getMinWeightRatio(TransportMode mode) const {
+        return minWeightRatio[static_cast<int>(mode)];
+    }
+
+    const SpatialIndex& getSpatialIndex() const { return spatialIndex; }
+
+    Edge getEdge(NodeId from, uint32_t e) const {
+        return Edge(getLocation(from), getLocation(edgeTargets[e]), edgeWeights[e], edgeModes[e]);
+    }
+
+    // Appends edge e, leaving `from`, to path as its original segments
+    void appendEdge(NodeId from, uint32_t e, std::vector<Edge>& path) const {
+        if (!hasShape(e)) {
+            path.push_back(getEdge(from, e));
+            return;
+        }
+        for (uint32_t i = shapeOffsets[e]; i < shapeOffsets[e + 1]; i++) {
+            path.push_back(Edge(getLocation(from), getLocation(shapeTargets[i]), shapeWeights[i], edgeModes[e]));
+            from = shapeTargets[i];
+        }
+    }
+
+    // Original segments of edge e, as shape table indexes; an empty range
+    // for a plain edge
+    uint32_t shapeBegin(uint32_t e) const { return shapeOffsets.empty() ? 0 : shapeOffsets[e]; }
+    uint32_t shapeEnd(uint32_t e) const { return shapeOffsets.empty() ? 0 : shapeOffsets[e + 1]; }
+    NodeId shapeTarget(uint32_t i) const { return shapeTargets[i]; }
+    double shapeWeight(uint32_t i) const { return shapeWeights[i]; }
+
+    // How many original segments edge e stands for
+    uint32_t edgeSegmentCount(uint32_t e) const {
+        return hasShape(e) ? shapeOffsets[e + 1] - shapeOffsets[e] : 1;
+    }
+
+    // Whether node was folded into a chain edge by contractChains()
+    bool isShapePoint(NodeId node) const {
+        return !shapeEdgeOf.empty() && shapeEdgeOf[node] != NO_EDGE;
+    }
+
+    // A chain edge passing through shape point node, NO_EDGE for others
+    uint32_t getShapeEdge(NodeId node) const {
+        return shapeEdgeOf.empty() ? NO_EDGE : shapeEdgeOf[node];
+    }
+
+    // Edges whose geometry includes the original segment from -> to: the
+    // plain edge itself, or the chain edges that were folded over it.
+    // segments[i] is where it lies in edges[i] (see findSegment).
+    void findEdgesThrough(NodeId from, NodeId to, std::vector<uint32_t>& edges,
+                          std::vector<uint32_t>& segments) const {
+        edges.clear();
+        segments.clear();
+        if (from == INVALID_NODE || to == INVALID_NODE) return;
+        auto check = [&](uint32_t e) {
+            uint32_t segment = findSegment(e, from, to);
+            if (segment == NO_SEGMENT) return;
+            edges.push_back(e);
+            segments.push_back(segment);
+        };
+        if (!isShapePoint(from)) {
+            for (uint32_t e = edgeOffsets[from]; e < edgeOffsets[from + 1]; e++) check(e);
+            return;
+        }
+        // A chain through a shape point is this edge or, if two-way, one of
+        // the edges leaving its far end
+        uint32_t chain = shapeEdgeOf[from];
+        check(chain);
+        NodeId end = edgeTargets[chain];
+        for (uint32_t e = edgeOffsets[end]; e < edgeOffsets[end + 1]; e++) {
+            if (e != chain && hasShape(e)) check(e);
+        }
     }
-    
-    void addMetroStation(const Location& loc, const std::string& name) {
-        metroStations[loc] = name;
+
+    void addMetroStation(NodeId node, const std::string& name) {
+        metroStations[node] = name;
+    }
+
+    void addBikolpoStop(NodeId node, const std::string& name) {
+        bikolpoStops[node] = name;
+    }
+
+    void addUttaraStop(NodeId node, const std::string& name) {
+        uttaraStops[node] = name;
     }
-    
-    void addBikolpoStop(const Location& loc, const std::string& name) {
-        bikolpoStops[loc] = name;
+
+    static const uint32_t NO_STATION_NAME = 0xFFFFFFFFu;
+
+    // Interned name of the station at node, or NO_STATION_NAME; only valid
+    // once frozen
+    uint32_t getStationNameId(NodeId node) const {
+        auto it = stationNameIds.find(node);
+        return it != stationNameIds.end() ? it->second : NO_STATION_NAME;
     }
-    
-    void addUttaraStop(const Location& loc, const std::string& name) {
-        uttaraStops[loc] = name;
+
+    const std::string& getStationNameById(uint32_t id) const {
+        static const std::string none;
+        return id < stationNames.size() ? stationNames[id] : none;
+    }
+
+    std::string getStationName(NodeId node) const {
+        return getStationNameById(getStationNameId(node));
     }
-    
+
     std::string getStationName(const Location& loc) const {
-        auto it = metroStations.find(loc);
-        if (it != metroStations.end()) return it->second;
-        
-        it = bikolpoStops.find(loc);
-        if (it != bikolpoStops.end()) return it->second;
-        
-        it = uttaraStops.find(loc);
-        if (it != uttaraStops.end()) return it->second;
-        
-        return "";
-    }
-    
+        NodeId node = findNode(loc);
+        return (node != INVALID_NODE) ? getStationName(node) : "";
+    }
+
+    NodeId findNearestNode(const Location& target) const {
+        return spatialIndex.nearest(target);
+    }
+
+    // Snaps every point in one pass; result[i] is the node nearest targets[i]
+    void findNearestNodes(const std::vector<Location>& targets, std::vector<NodeId>& result) const {
+        spatialIndex.nearestBatch(targets, result);
+    }
+
+    std::vector<NodeId> findNearestNodes(const Location& target, size_t k) const {
+        return spatialIndex.nearestK(target, k);
+    }
+
+    std::vector<NodeId> findNodesWithinRadius(const Location& target, double radiusKm) const {
+        return spatialIndex.withinRadius(target, radiusKm);
+    }
+
+    // Distance from target to every node, in node ID order, with the batch
+    // kernels (see GeoKernels for their accuracy)
+    void distancesFrom(const Location& target, std::vector<double>& out,
+                       DistanceMode mode = DistanceMode::HAVERSINE) const {
+        out.resize(spatialIndex.size());
+        GeoKernels::distancesFrom(target, spatialIndex.points(), out.size(), out.data(), mode);
+    }
+
     Location findNearestLocation(const Location& target) const {
-        if (locations.empty()) return target;
-        
-        double minDist = std::numeric_limits<double>::max();
-        Location nearest = target;
-        
-        for (const auto& loc : locations) {
-            double dist = haversineDistance(target, loc);
-            if (dist < minDist) {
-                minDist = dist;
-                nearest = loc;
-            }
-        }
-        
-        return nearest;
+        NodeId nearest = findNearestNode(target);
+        return (nearest != INVALID_NODE) ? getLocation(nearest) : target;
     }
-    
+
     double distanceToNearestLocation(const Location& target) const {
         Location nearest = findNearestLocation(target);
         return haversineDistance(target, nearest);
     }
-    
+
     size_t getLocationCount() const {
-        return locations.size();
+        return nodeLat.size();
     }
-    
+
     size_t getEdgeCount() const {
-        size_t count = 0;
-        for (const auto& pair : adjacencyList) {
-            count += pair.second.size();
-        }
-        return count;
+        return frozen ? edgeTargets.size() : buildFrom.size();
     }
 };
 
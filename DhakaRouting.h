@@ -8,12 +8,14 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <queue>
 #include <cmath>
 #include <limits>
 #include <iomanip>
 #include <algorithm>
 #include <functional>
+#include <cstdint>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -21,9 +23,17 @@
 
 const double EARTH_RADIUS_KM = 6371.0;
 const double WALK_SPEED_KMH = 2.0;
+// Walking connectors between stops and the road network (linkTransfers)
+const double TRANSFER_RADIUS_KM = 0.4;
+const size_t TRANSFER_ROAD_LINKS = 3;
+// Walks to or from the network shorter than this are not reported
+const double MIN_WALK_KM = 0.001;
 const double EPSILON = 1e-6;
 
-enum class TransportMode {
+typedef uint32_t NodeId;
+const NodeId INVALID_NODE = 0xFFFFFFFFu;
+
+enum class TransportMode : uint8_t {
     WALK,
     CAR,
     METRO,
@@ -31,6 +41,8 @@ enum class TransportMode {
     BUS_UTTARA
 };
 
+const int MODE_COUNT = 5;
+
 struct Location {
     double lat;
     double lon;
@@ -0,0 +1,93 @@
+#ifndef FLAT_ARRAY_H
+#define FLAT_ARRAY_H
+
+#include <vector>
+#include <cstddef>
+
+// Contiguous array that either owns its elements (built in memory) or is a
+// read-only view into a memory-mapped snapshot. It supports the subset of
+// std::vector used by the frozen graph structures; mutating calls are only
+// valid on owned arrays.
+template <typename T>
+class FlatArray {
+private:
+    std::vector<T> storage;
+    const T* ptr;
+    size_t count;
+
+    void sync() {
+        ptr = storage.data();
+        count = storage.size();
+    }
+
+public:
+    FlatArray() : ptr(nullptr), count(0) {}
+
+    FlatArray(const FlatArray& other) : storage(other.storage), ptr(other.ptr), count(other.count) {
+        if (other.isOwned()) sync();
+    }
+
+    FlatArray& operator=(const FlatArray& other) {
+        if (this != &other) {
+            storage = other.storage;
+            ptr = other.ptr;
+            count = other.count;
+            if (other.isOwned()) sync();
+        }
+        return *this;
+    }
+
+    bool isOwned() const { return ptr == storage.data(); }
+
+    // Takes ownership of the vector's contents
+    void adopt(std::vector<T>& source) {
+        storage.swap(source);
+        std::vector<T>().swap(source);
+        sync();
+    }
+
+    // Points at externally owned memory, which must outlive this array
+    void view(const T* data, size_t size) {
+        std::vector<T>().swap(storage);
+        ptr = data;
+        count = size;
+    }
+
+    void push_back(const T& value) {
+        storage.push_back(value);
+        sync();
+    }
+
+    void resize(size_t size) {
+        storage.resize(size);
+        sync();
+    }
+
+    void assign(size_t size, const T& value) {
+        storage.assign(size, value);
+        sync();
+    }
+
+    void reserve(size_t size) {
+        storage.reserve(size);
+        sync();
+    }
+
+    void clear() {
+        std::vector<T>().swap(storage);
+        sync();
+    }
+
+    // Writable access is for owned arrays; on a view it aliases read-only
+    // mapped memory
+    T& operator[](size_t i) { return const_cast<T*>(ptr)[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + count; }
+};
+
+#endif // FLAT_ARRAY_H
@@ -0,0 +1,191 @@
+#ifndef GRAPH_SNAPSHOT_H
+#define GRAPH_SNAPSHOT_H
+
+#include "DhakaRouting.h"
+#include "FlatArray.h"
+#include "MappedFile.h"
+#include <memory>
+#include <deque>
+#include <cstring>
+
+// Snapshot file layout (native byte order, checked on load):
+//   SnapshotHeader
+//   SnapshotSection[sectionCount]
+//   section payloads, each starting on a SNAPSHOT_ALIGNMENT boundary
+// Payloads are raw arrays, so a loader maps the file and points FlatArrays
+// straight at them without parsing anything.
+const char SNAPSHOT_MAGIC[8] = {'D', 'H', 'A', 'K', 'A', 'S', 'N', 'P'};
+const uint32_t SNAPSHOT_VERSION = 2;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304u;
+const uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t sectionCount;
+    uint32_t reserved;
+};
+
+struct SnapshotSection {
+    char name[40];
+    uint64_t offset;
+    uint64_t size;
+};
+
+class SnapshotWriter {
+private:
+    struct Pending {
+        std::string name;
+        const void* data;
+        size_t size;
+    };
+
+    std::vector<Pending> sections;
+    std::deque<std::vector<char>> ownedBlobs;
+
+public:
+    // Records a section; data must stay alive until write()
+    void add(const std::string& name, const void* data, size_t size) {
+        Pending p;
+        p.name = name;
+        p.data = data;
+        p.size = size;
+        sections.push_back(p);
+    }
+
+    // Copies the bytes, for sections assembled on the fly
+    void addCopy(const std::string& name, const std::vector<char>& bytes) {
+        ownedBlobs.push_back(bytes);
+        add(name, ownedBlobs.back().data(), ownedBlobs.back().size());
+    }
+
+    template <typename T>
+    void addArray(const std::string& name, const FlatArray<T>& array) {
+        add(name, array.data(), array.size() * sizeof(T));
+    }
+
+    template <typename T>
+    void addValue(const std::string& name, const T& value) {
+        std::vector<char> bytes(sizeof(T));
+        std::memcpy(bytes.data(), &value, sizeof(T));
+        addCopy(name, bytes);
+    }
+
+    bool write(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write snapshot " << filename << std::endl;
+            return false;
+        }
+
+        SnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER;
+        header.sectionCount = static_cast<uint32_t>(sections.size());
+
+        std::vector<SnapshotSection> table(sections.size());
+        uint64_t offset = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+        for (size_t i = 0; i < sections.size(); i++) {
+            offset = (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+            std::memset(&table[i], 0, sizeof(SnapshotSection));
+            std::strncpy(table[i].name, sections[i].name.c_str(), sizeof(table[i].name) - 1);
+            table[i].offset = offset;
+            table[i].size = sections[i].size;
+            offset += sections[i].size;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SnapshotSection));
+        uint64_t written = sizeof(SnapshotHeader) + table.size() * sizeof(SnapshotSection);
+        const char padding[SNAPSHOT_ALIGNMENT] = {0};
+        for (size_t i = 0; i < sections.size(); i++) {
+            file.write(padding, table[i].offset - written);
+            file.write(static_cast<const char*>(sections[i].data), sections[i].size);
+            written = table[i].offset + sections[i].size;
+        }
+        return file.good();
+    }
+};
+
+class SnapshotReader {
+private:
+    std::shared_ptr<MappedFile> file;
+    const SnapshotSection* table;
+    uint32_t sectionCount;
+
+    const SnapshotSection* find(const std::string& name) const {
+        for (uint32_t i = 0; i < sectionCount; i++) {
+            if (std::strncmp(table[i].name, name.c_str(), sizeof(table[i].name)) == 0) return &table[i];
+        }
+        return nullptr;
+    }
+
+public:
+    SnapshotReader() : table(nullptr), sectionCount(0) {}
+
+    bool open(const std::string& filename) {
+        file.reset(new MappedFile());
+        if (!file->open(filename)) {
+            std::cerr << "Error: Cannot open snapshot " << filename << std::endl;
+            return false;
+        }
+
+        const SnapshotHeader* header = reinterpret_cast<const SnapshotHeader*>(file->data());
+        if (file->size() < sizeof(SnapshotHeader) ||
+            std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+            header->byteOrder != SNAPSHOT_BYTE_ORDER) {
+            std::cerr << "Error: " << filename << " is not a graph snapshot" << std::endl;
+            return false;
+        }
+        if (header->version != SNAPSHOT_VERSION) {
+            std::cerr << "Error: Snapshot version " << header->version << " (expected "
+                      << SNAPSHOT_VERSION << "), rebuild it with --build-snapshot" << std::endl;
+            return false;
+        }
+
+        sectionCount = header->sectionCount;
+        table = reinterpret_cast<const SnapshotSection*>(file->data() + sizeof(SnapshotHeader));
+        if (sizeof(SnapshotHeader) + sectionCount * sizeof(SnapshotSection) > file->size()) return false;
+        for (uint32_t i = 0; i < sectionCount; i++) {
+            if (table[i].offset + table[i].size > file->size()) return false;
+        }
+        return true;
+    }
+
+    // Keeps the mapping alive for as long as any structure viewing it
+    std::shared_ptr<const void> mapping() const { return file; }
+
+    bool getBytes(const std::string& name, const char*& data, size_t& size) const {
+        const SnapshotSection* section = find(name);
+        if (section == nullptr) {
+            std::cerr << "Error: Snapshot is missing section " << name << std::endl;
+            return false;
+        }
+        data = file->data() + section->offset;
+        size = section->size;
+        return true;
+    }
+
+    template <typename T>
+    bool getArray(const std::string& name, FlatArray<T>& array) const {
+        const char* data;
+        size_t size;
+        if (!getBytes(name, data, size) || size % sizeof(T) != 0) return false;
+        array.view(reinterpret_cast<const T*>(data), size / sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    bool getValue(const std::string& name, T& value) const {
+        const char* data;
+        size_t size;
+        if (!getBytes(name, data, size) || size != sizeof(T)) return false;
+        std::memcpy(&value, data, sizeof(T));
+        return true;
+    }
+};
+
+#endif // GRAPH_SNAPSHOT_H
@@ -0,0 +1,307 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include "DhakaRouting.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+// Search and load-path instrumentation. Build with
+// -DDHAKA_NO_INSTRUMENTATION to compile every probe out: counters are not
+// bumped, clocks are not read and nothing reaches the registry. Otherwise
+// the hot path only touches the calling thread's own counters, so it is
+// cheap enough to leave on.
+#ifdef DHAKA_NO_INSTRUMENTATION
+#define DHAKA_INSTRUMENTED 0
+#else
+#define DHAKA_INSTRUMENTED 1
+#endif
+
+#define DHAKA_COUNT(counter, n) \
+    do { \
+        if (DHAKA_INSTRUMENTED) (counter) += (n); \
+    } while (0)
+
+// What one query cost. settledNodes is always counted; the rest only when
+// instrumented. Edge and heap counters cover the Problem 1-3 searches.
+struct SearchStats {
+    size_t settledNodes;
+    size_t edgesRelaxed;
+    size_t heapPushes;
+    size_t heapPops;
+    double snapMicros;
+    double searchMicros;
+    double pathMicros;
+
+    SearchStats()
+        : settledNodes(0), edgesRelaxed(0), heapPushes(0), heapPops(0), snapMicros(0.0), searchMicros(0.0),
+          pathMicros(0.0) {}
+};
+
+// Microseconds between laps; reads no clock when instrumentation is off
+class Stopwatch {
+private:
+    std::chrono::steady_clock::time_point last;
+
+public:
+    Stopwatch() {
+        if (DHAKA_INSTRUMENTED) last = std::chrono::steady_clock::now();
+    }
+
+    double lapMicros() {
+        if (!DHAKA_INSTRUMENTED) return 0.0;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        double micros = std::chrono::duration<double, std::micro>(now - last).count();
+        last = now;
+        return micros;
+    }
+};
+
+// Process-wide aggregate of per-query SearchStats, as log2 histograms per
+// problem, plus the duration of each load phase. Each thread records into
+// its own slot, registered once under the lock and written only by that
+// thread afterwards (relaxed loads and stores, no read-modify-write), so
+// recordQuery never blocks. Dumps sum every slot and may run at any time.
+class StatsRegistry {
+public:
+    enum Metric {
+        SETTLED_NODES,
+        EDGES_RELAXED,
+        HEAP_PUSHES,
+        HEAP_POPS,
+        SNAP_TIME,
+        SEARCH_TIME,
+        PATH_TIME,
+        METRIC_COUNT
+    };
+
+    // Problem 0 collects queries outside Problems 1-6 (Pareto frontiers)
+    static const int PROBLEM_SLOTS = 7;
+    // Bucket b counts values below 2^b (times in nanoseconds); the last
+    // one also takes everything larger
+    static const int BUCKETS = 40;
+
+private:
+    struct Histogram {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+    };
+
+    struct Slot {
+        Histogram histograms[PROBLEM_SLOTS][METRIC_COUNT];
+
+        Slot() {
+            for (int p = 0; p < PROBLEM_SLOTS; p++) {
+                for (int m = 0; m < METRIC_COUNT; m++) {
+                    for (int b = 0; b < BUCKETS; b++) histograms[p][m].buckets[b].store(0, std::memory_order_relaxed);
+                    histograms[p][m].sum.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+    };
+
+    struct Totals {
+        uint64_t buckets[BUCKETS];
+        uint64_t sum;
+        uint64_t count;
+    };
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<std::pair<std::string, double>> phases;
+
+    StatsRegistry() {}
+    StatsRegistry(const StatsRegistry&);
+    StatsRegistry& operator=(const StatsRegistry&);
+
+    // Only the owning thread writes a slot
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static int bucketOf(uint64_t value) {
+        int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+        return std::min(bucket, BUCKETS - 1);
+    }
+
+    static bool isTime(int metric) { return metric >= SNAP_TIME; }
+
+    static const char* metricName(int metric) {
+        static const char* const names[METRIC_COUNT] = {"settled_nodes", "edges_relaxed", "heap_pushes",
+                                                        "heap_pops", "snap_seconds", "search_seconds",
+                                                        "path_seconds"};
+        return names[metric];
+    }
+
+    Slot& threadSlot() {
+        static thread_local Slot* slot = nullptr;
+        if (slot == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots.push_back(std::unique_ptr<Slot>(new Slot()));
+            slot = slots.back().get();
+        }
+        return *slot;
+    }
+
+    void record(Slot& slot, int problem, int metric, uint64_t value) {
+        Histogram& h = slot.histograms[problem][metric];
+        bump(h.buckets[bucketOf(value)], 1);
+        bump(h.sum, value);
+    }
+
+    // Caller holds the mutex
+    Totals totals(int problem, int metric) const {
+        Totals t;
+        std::fill(t.buckets, t.buckets + BUCKETS, 0);
+        t.sum = 0;
+        t.count = 0;
+        for (size_t s = 0; s < slots.size(); s++) {
+            const Histogram& h = slots[s]->histograms[problem][metric];
+            for (int b = 0; b < BUCKETS; b++) t.buckets[b] += h.buckets[b].load(std::memory_order_relaxed);
+            t.sum += h.sum.load(std::memory_order_relaxed);
+        }
+        for (int b = 0; b < BUCKETS; b++) t.count += t.buckets[b];
+        return t;
+    }
+
+    static int lastUsedBucket(const Totals& t) {
+        int last = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            if (t.buckets[b] > 0) last = b;
+        }
+        return last;
+    }
+
+    // Upper bound of bucket b in the metric's exported unit
+    static double bucketBound(int metric, int b) {
+        double bound = static_cast<double>(uint64_t(1) << b);
+        return isTime(metric) ? bound * 1e-9 : bound;
+    }
+
+    static double exportedSum(int metric, uint64_t sum) {
+        return isTime(metric) ? sum * 1e-9 : static_cast<double>(sum);
+    }
+
+public:
+    static StatsRegistry& global() {
+        static StatsRegistry registry;
+        return registry;
+    }
+
+    void recordQuery(int problem, const SearchStats& stats) {
+        if (!DHAKA_INSTRUMENTED) return;
+        if (problem < 0 || problem >= PROBLEM_SLOTS) problem = 0;
+        Slot& slot = threadSlot();
+        record(slot, problem, SETTLED_NODES, stats.settledNodes);
+        record(slot, problem, EDGES_RELAXED, stats.edgesRelaxed);
+        record(slot, problem, HEAP_PUSHES, stats.heapPushes);
+        record(slot, problem, HEAP_POPS, stats.heapPops);
+        record(slot, problem, SNAP_TIME, static_cast<uint64_t>(stats.snapMicros * 1000.0 + 0.5));
+        record(slot, problem, SEARCH_TIME, static_cast<uint64_t>(stats.searchMicros * 1000.0 + 0.5));
+        record(slot, problem, PATH_TIME, static_cast<uint64_t>(stats.pathMicros * 1000.0 + 0.5));
+    }
+
+    // Load-path phases are rare, so they just take the lock. A phase run
+    // again (a reload) replaces its previous duration.
+    void recordPhase(const std::string& name, double micros) {
+        if (!DHAKA_INSTRUMENTED) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < phases.size(); i++) {
+            if (phases[i].first == name) {
+                phases[i].second = micros;
+                return;
+            }
+        }
+        phases.push_back(std::make_pair(name, micros));
+    }
+
+    // {"phases": {name: seconds}, "queries": {"problemN": {"count": n,
+    //  metric: {"sum": s, "buckets": [[le, count], ...]}}}}; times in
+    // seconds, buckets non-cumulative and trimmed after the last non-empty
+    void writeJSON(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "{\n  \"phases\": {";
+        for (size_t i = 0; i < phases.size(); i++) {
+            out << (i > 0 ? "," : "") << "\n    \"" << phases[i].first << "\": " << phases[i].second * 1e-6;
+        }
+        out << "\n  },\n  \"queries\": {";
+        bool firstProblem = true;
+        for (int p = 0; p < PROBLEM_SLOTS; p++) {
+            Totals settled = totals(p, SETTLED_NODES);
+            if (settled.count == 0) continue;
+            out << (firstProblem ? "" : ",") << "\n    \"" << (p == 0 ? std::string("other") : "problem" + std::to_string(p))
+                << "\": {\n      \"count\": " << settled.count;
+            firstProblem = false;
+            for (int m = 0; m < METRIC_COUNT; m++) {
+                Totals t = totals(p, m);
+                out << ",\n      \"" << metricName(m) << "\": {\"sum\": " << exportedSum(m, t.sum) << ", \"buckets\": [";
+                int last = lastUsedBucket(t);
+                for (int b = 0; b <= last; b++) {
+                    out << (b > 0 ? ", " : "") << "[" << bucketBound(m, b) << ", " << t.buckets[b] << "]";
+                }
+                out << "]}";
+            }
+            out << "\n    }";
+        }
+        out << "\n  }\n}\n";
+    }
+
+    // Prometheus text exposition format: one histogram per metric labelled
+    // by problem, and a gauge per load phase
+    void writePrometheus(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        out << "# HELP dhaka_load_phase_seconds Duration of each graph load phase\n"
+            << "# TYPE dhaka_load_phase_seconds gauge\n";
+        for (size_t i = 0; i < phases.size(); i++) {
+            out << "dhaka_load_phase_seconds{phase=\"" << phases[i].first << "\"} " << phases[i].second * 1e-6 << "\n";
+        }
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            std::string name = std::string("dhaka_query_") + metricName(m);
+            out << "# HELP " << name << " Per-query " << metricName(m) << "\n# TYPE " << name << " histogram\n";
+            for (int p = 0; p < PROBLEM_SLOTS; p++) {
+                Totals t = totals(p, m);
+                if (t.count == 0) continue;
+                std::string label = "problem=\"" + (p == 0 ? std::string("other") : std::to_string(p)) + "\"";
+                uint64_t cumulative = 0;
+                int last = lastUsedBucket(t);
+                for (int b = 0; b <= last; b++) {
+                    cumulative += t.buckets[b];
+                    out << name << "_bucket{" << label << ",le=\"" << bucketBound(m, b) << "\"} " << cumulative << "\n";
+                }
+                out << name << "_bucket{" << label << ",le=\"+Inf\"} " << t.count << "\n"
+                    << name << "_sum{" << label << "} " << exportedSum(m, t.sum) << "\n"
+                    << name << "_count{" << label << "} " << t.count << "\n";
+            }
+        }
+    }
+
+    // Prometheus text if the file ends in .prom, JSON otherwise
+    bool writeFile(const std::string& filename) {
+        std::ofstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot create " << filename << std::endl;
+            return false;
+        }
+        file << std::setprecision(9);
+        bool prometheus = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".prom") == 0;
+        if (prometheus) writePrometheus(file);
+        else writeJSON(file);
+        return file.good();
+    }
+};
+
+// Records the lifetime of a scope as a load phase
+class ScopedPhase {
+private:
+    const char* name;
+    Stopwatch watch;
+
+public:
+    explicit ScopedPhase(const char* phaseName) : name(phaseName) {}
+    ~ScopedPhase() {
+        if (DHAKA_INSTRUMENTED) StatsRegistry::global().recordPhase(name, watch.lapMicros());
+    }
+};
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,119 @@
+#ifndef ISOCHRONE_H
+#define ISOCHRONE_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+
+struct ReachedNode {
+    NodeId node;
+    double cost;
+
+    bool operator<(const ReachedNode& other) const {
+        return node < other.node || (node == other.node && cost < other.cost);
+    }
+};
+
+// Everything reachable from `origin` within `budget` under one of the
+// Problem 1-3 cost models (km for Problem 1, Tk for 2 and 3): every node
+// reached, by node ID, with the cost of getting there including the walk
+// from the origin to the snapped source. Shape points folded into chain
+// edges are listed too, priced pro rata along their chain, so the set
+// follows the full road geometry.
+struct Isochrone {
+    Location origin;
+    NodeId source;
+    int problem;
+    double budget;
+    std::vector<ReachedNode> nodes;
+
+    Isochrone() : source(INVALID_NODE), problem(0), budget(0.0) {}
+
+    void clear() {
+        source = INVALID_NODE;
+        nodes.clear();
+    }
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return nodes.size(); }
+};
+
+// Reach costs bucketed into square cells about cellKm on a side over the
+// graph's bounding box. Each cell keeps the lowest cost of any node in it
+// over every isochrone added, so adding one isochrone per depot gives a
+// coverage map. Cells nothing reached stay infinite.
+class IsochroneGrid {
+public:
+    static constexpr double DEFAULT_CELL_KM = 0.25;
+
+private:
+    double cellKm;
+    double minLat, minLon;
+    double cellLat, cellLon;  // degrees
+    uint32_t rowCount, colCount;
+    std::vector<double> cells;
+
+public:
+    explicit IsochroneGrid(const DhakaGraph& graph, double sizeKm = DEFAULT_CELL_KM)
+        : cellKm(sizeKm), minLat(0.0), minLon(0.0), cellLat(1.0), cellLon(1.0), rowCount(0), colCount(0) {
+        size_t n = graph.getLocationCount();
+        if (n == 0 || !(sizeKm > 0.0)) return;
+
+        double maxLat = -90.0, maxLon = -180.0;
+        minLat = 90.0;
+        minLon = 180.0;
+        for (NodeId u = 0; u < n; u++) {
+            Location loc = graph.getLocation(u);
+            minLat = std::min(minLat, loc.lat);
+            maxLat = std::max(maxLat, loc.lat);
+            minLon = std::min(minLon, loc.lon);
+            maxLon = std::max(maxLon, loc.lon);
+        }
+        cellLat = sizeKm / (EARTH_RADIUS_KM * M_PI / 180.0);
+        cellLon = cellLat / std::cos(toRadians((minLat + maxLat) / 2));
+        rowCount = static_cast<uint32_t>((maxLat - minLat) / cellLat) + 1;
+        colCount = static_cast<uint32_t>((maxLon - minLon) / cellLon) + 1;
+        cells.assign(static_cast<size_t>(rowCount) * colCount, std::numeric_limits<double>::infinity());
+    }
+
+    uint32_t rows() const { return rowCount; }
+    uint32_t cols() const { return colCount; }
+    double getCellKm() const { return cellKm; }
+    double at(uint32_t row, uint32_t col) const { return cells[static_cast<size_t>(row) * colCount + col]; }
+
+    // South-west and north-east corners of a cell
+    Location cellMin(uint32_t row, uint32_t col) const {
+        return Location(minLat + row * cellLat, minLon + col * cellLon);
+    }
+
+    Location cellMax(uint32_t row, uint32_t col) const {
+        return Location(minLat + (row + 1) * cellLat, minLon + (col + 1) * cellLon);
+    }
+
+    void clear() { std::fill(cells.begin(), cells.end(), std::numeric_limits<double>::infinity()); }
+
+    void add(const DhakaGraph& graph, const Isochrone& isochrone) {
+        if (cells.empty()) return;
+        for (size_t i = 0; i < isochrone.nodes.size(); i++) {
+            Location loc = graph.getLocation(isochrone.nodes[i].node);
+            uint32_t row = std::min(rowCount - 1, static_cast<uint32_t>((loc.lat - minLat) / cellLat));
+            uint32_t col = std::min(colCount - 1, static_cast<uint32_t>((loc.lon - minLon) / cellLon));
+            double& cell = cells[static_cast<size_t>(row) * colCount + col];
+            cell = std::min(cell, isochrone.nodes[i].cost);
+        }
+    }
+
+    // Cell-wise minimum with a grid built over the same graph and cell size
+    void merge(const IsochroneGrid& other) {
+        for (size_t i = 0; i < cells.size() && i < other.cells.size(); i++) {
+            cells[i] = std::min(cells[i], other.cells[i]);
+        }
+    }
+
+    size_t reachedCells() const {
+        size_t count = 0;
+        for (size_t i = 0; i < cells.size(); i++) count += !std::isinf(cells[i]);
+        return count;
+    }
+};
+
+#endif // ISOCHRONE_H
@@ -0,0 +1,252 @@
+#ifndef LIVE_TRAFFIC_H
+#define LIVE_TRAFFIC_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "CostModels.h"
+#include "ContractionHierarchy.h"
+#include <memory>
+#include <mutex>
+
+// One published state of the road network under live traffic. weights
+// holds a routing weight per graph edge: the edge length divided by its
+// speed factor (1 = free flow), or infinity for a closed edge. A chain
+// edge (see DhakaGraph::contractChains) keeps a factor per original
+// segment in segmentFactors, by shape table index, and weighs the sum of
+// its segments' lengths over their factors. The car hierarchy, if any, is
+// customized for exactly these weights. Snapshots are immutable once
+// published, so a query that pins one sees the same network from start to
+// finish.
+struct TrafficSnapshot {
+    uint32_t version;
+    std::vector<double> weights;
+    std::vector<double> segmentFactors;  // empty until a chain edge changes
+    std::shared_ptr<const ContractionHierarchy> carHierarchy;
+    size_t closedEdges;
+    size_t slowedEdges;
+
+    TrafficSnapshot() : version(0), closedEdges(0), slowedEdges(0) {}
+};
+
+// A new speed factor for one graph edge, or for one segment of a chain
+// edge given its shape table index: 0 closes it, 1 restores free flow
+struct TrafficUpdate {
+    uint32_t edge;
+    uint32_t segment;  // DhakaGraph::WHOLE_EDGE for all of it
+    double factor;
+
+    TrafficUpdate() : edge(0), segment(DhakaGraph::WHOLE_EDGE), factor(1.0) {}
+};
+
+// Updates that arrived together in the feed, at `minute` past midnight
+struct TrafficBatch {
+    double minute;
+    std::vector<TrafficUpdate> updates;
+};
+
+// Search cost of edge e under a pinned snapshot's weights (null means free
+// flow). Closed edges cost infinity under every model; only models that
+// price travel time (CostModel::pricesCongestion) pay for slow edges, so
+// congestion reroutes Problem 1 but never changes a fare.
+template <typename CostModel>
+inline double liveEdgeCost(const DhakaGraph& graph, const double* live, uint32_t e, TransportMode mode) {
+    if (live == nullptr) return CostModel::cost(graph.edgeWeight(e), mode);
+    if (std::isinf(live[e])) return live[e];
+    return CostModel::cost(CostModel::pricesCongestion ? live[e] : graph.edgeWeight(e), mode);
+}
+
+// Live edge conditions over a DhakaGraph, kept apart from its immutable
+// edge weights. Writers apply batches of updates copy-on-write and publish
+// the result with an atomic pointer swap; readers pin the current snapshot
+// with snapshot() and never block. With a base car hierarchy, every
+// publish re-customizes it in the base node order instead of rebuilding.
+class LiveTraffic {
+private:
+    const DhakaGraph& graph;
+    const ContractionHierarchy* baseHierarchy;
+    std::shared_ptr<const TrafficSnapshot> current;  // null while free flow
+    std::mutex writerMutex;
+    uint32_t nextVersion;
+
+    LiveTraffic(const LiveTraffic&);
+    LiveTraffic& operator=(const LiveTraffic&);
+
+    static bool isRoadMode(TransportMode mode) {
+        return mode == TransportMode::CAR || mode == TransportMode::BUS_BIKOLPO ||
+               mode == TransportMode::BUS_UTTARA;
+    }
+
+    // Chain edge e under per-segment factors: closed if any segment is,
+    // exactly its free-flow weight if none is slowed
+    double chainWeight(uint32_t e, const std::vector<double>& factors) const {
+        double weight = 0.0;
+        bool slowed = false;
+        for (uint32_t i = graph.shapeBegin(e); i < graph.shapeEnd(e); i++) {
+            if (factors[i] == 0.0) return std::numeric_limits<double>::infinity();
+            if (factors[i] != 1.0) slowed = true;
+            weight += graph.shapeWeight(i) / factors[i];
+        }
+        return slowed ? weight : graph.edgeWeight(e);
+    }
+
+    void publish(std::shared_ptr<TrafficSnapshot> next) {
+        if (next) {
+            next->version = nextVersion++;
+            if (baseHierarchy != nullptr && !baseHierarchy->empty()) {
+                std::shared_ptr<ContractionHierarchy> ch(new ContractionHierarchy());
+                ch->customize(*baseHierarchy, next->weights.data());
+                next->carHierarchy = ch;
+            }
+        }
+        std::atomic_store(&current, std::shared_ptr<const TrafficSnapshot>(next));
+    }
+
+public:
+    // baseHierarchy may be null, in which case Problem 1 falls back to a
+    // plain search while traffic is applied
+    explicit LiveTraffic(const DhakaGraph& g, const ContractionHierarchy* ch = nullptr)
+        : graph(g), baseHierarchy(ch), nextVersion(1) {}
+
+    // The current snapshot, or null while the network is in free flow.
+    // Holding the pointer keeps that snapshot alive across later publishes.
+    std::shared_ptr<const TrafficSnapshot> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    // Applies updates on top of the current snapshot and publishes the
+    // result; returns its version. Factors are clamped to [0, 1], since
+    // free flow is the fastest an edge gets (which keeps the A* and CH
+    // lower bounds valid). An update to one segment of a chain edge slows
+    // or closes only that stretch of it.
+    uint32_t apply(const std::vector<TrafficUpdate>& updates) {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        std::shared_ptr<const TrafficSnapshot> base = snapshot();
+
+        std::shared_ptr<TrafficSnapshot> next(new TrafficSnapshot());
+        if (base) {
+            next->weights = base->weights;
+            next->segmentFactors = base->segmentFactors;
+            next->closedEdges = base->closedEdges;
+            next->slowedEdges = base->slowedEdges;
+        } else {
+            next->weights.resize(graph.getEdgeCount());
+            for (uint32_t e = 0; e < next->weights.size(); e++) {
+                next->weights[e] = graph.edgeWeight(e);
+            }
+        }
+
+        for (size_t i = 0; i < updates.size(); i++) {
+            uint32_t e = updates[i].edge;
+            if (e >= next->weights.size()) continue;
+            double factor = std::min(1.0, std::max(0.0, updates[i].factor));
+            uint32_t segment = updates[i].segment;
+            uint32_t shapeBegin = graph.shapeBegin(e), shapeEnd = graph.shapeEnd(e);
+            bool chain = shapeBegin != shapeEnd;
+            if (chain && segment != DhakaGraph::WHOLE_EDGE && (segment < shapeBegin || segment >= shapeEnd)) continue;
+            double& weight = next->weights[e];
+
+            if (std::isinf(weight)) next->closedEdges--;
+            else if (weight != graph.edgeWeight(e)) next->slowedEdges--;
+
+            if (chain) {
+                if (next->segmentFactors.empty()) next->segmentFactors.assign(graph.getShapePointCount(), 1.0);
+                if (segment == DhakaGraph::WHOLE_EDGE) {
+                    std::fill(next->segmentFactors.begin() + shapeBegin, next->segmentFactors.begin() + shapeEnd,
+                              factor);
+                } else {
+                    next->segmentFactors[segment] = factor;
+                }
+                weight = chainWeight(e, next->segmentFactors);
+            } else if (factor == 0.0) {
+                weight = std::numeric_limits<double>::infinity();
+            } else {
+                weight = graph.edgeWeight(e) / factor;
+            }
+
+            if (std::isinf(weight)) next->closedEdges++;
+            else if (weight != graph.edgeWeight(e)) next->slowedEdges++;
+        }
+
+        publish(next);
+        return next->version;
+    }
+
+    // Returns every edge to free flow
+    void reset() {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        publish(std::shared_ptr<TrafficSnapshot>());
+    }
+
+    // Road edges (car and bus) through the segment from one node to
+    // another, with where it lies in each (see DhakaGraph::findSegment),
+    // for feeds that name segments by their endpoints
+    void findRoadEdges(NodeId from, NodeId to, std::vector<uint32_t>& edges, std::vector<uint32_t>& segments) const {
+        graph.findEdgesThrough(from, to, edges, segments);
+        size_t kept = 0;
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (!isRoadMode(graph.edgeMode(edges[i]))) continue;
+            edges[kept] = edges[i];
+            segments[kept++] = segments[i];
+        }
+        edges.resize(kept);
+        segments.resize(kept);
+    }
+
+    // Reads a congestion feed: one "minute,fromLon,fromLat,toLon,toLat,factor"
+    // line per directed road segment, in time order. Consecutive lines with
+    // the same minute form one batch. Endpoints must be graph nodes; lines
+    // naming no road edge are counted in `unmatched` and skipped. Blank
+    // lines and # comments are ignored.
+    bool readFeed(const std::string& filename, std::vector<TrafficBatch>& batches, size_t& unmatched) const {
+        std::ifstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return false;
+        }
+
+        batches.clear();
+        unmatched = 0;
+        std::string line;
+        std::vector<CSVField> fields;
+        std::vector<uint32_t> edges;
+        std::vector<uint32_t> segments;
+        size_t lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#' || line == "\r") continue;
+
+            CSVParser::splitFields(line.data(), line.data() + line.size(), fields);
+            double minute, factor;
+            Location from, to;
+            if (fields.size() < 6 || !CSVParser::parseDouble(fields[0], minute) ||
+                !CSVParser::parseDouble(fields[1], from.lon) || !CSVParser::parseDouble(fields[2], from.lat) ||
+                !CSVParser::parseDouble(fields[3], to.lon) || !CSVParser::parseDouble(fields[4], to.lat) ||
+                !CSVParser::parseDouble(fields[5], factor)) {
+                std::cerr << "Error: " << filename << ":" << lineNumber << ": malformed traffic update" << std::endl;
+                return false;
+            }
+
+            findRoadEdges(graph.findNode(from), graph.findNode(to), edges, segments);
+            if (edges.empty()) {
+                unmatched++;
+                continue;
+            }
+            if (batches.empty() || batches.back().minute != minute) {
+                TrafficBatch batch;
+                batch.minute = minute;
+                batches.push_back(batch);
+            }
+            for (size_t i = 0; i < edges.size(); i++) {
+                TrafficUpdate update;
+                update.edge = edges[i];
+                update.segment = segments[i];
+                update.factor = factor;
+                batches.back().updates.push_back(update);
+            }
+        }
+        return true;
+    }
+};
+
+#endif // LIVE_TRAFFIC_H
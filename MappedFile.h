@@ -0,0 +1,90 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only mapping of a whole file; falls back to reading it into memory
+// where mmap is unavailable. An empty file opens as an empty range.
+class MappedFile {
+private:
+    const char* base;
+    size_t length;
+#ifdef _WIN32
+    std::vector<uint64_t> buffer;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+public:
+    MappedFile() : base(nullptr), length(0) {}
+
+    ~MappedFile() {
+#ifndef _WIN32
+        if (length > 0) munmap(const_cast<char*>(base), length);
+#endif
+    }
+
+    bool open(const std::string& filename) {
+#ifdef _WIN32
+        FILE* file = std::fopen(filename.c_str(), "rb");
+        if (file == nullptr) return false;
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if (size < 0) {
+            std::fclose(file);
+            return false;
+        }
+        if (size == 0) {
+            std::fclose(file);
+            base = "";
+            length = 0;
+            return true;
+        }
+        buffer.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        size_t got = std::fread(buffer.data(), 1, size, file);
+        std::fclose(file);
+        if (got != static_cast<size_t>(size)) return false;
+        base = reinterpret_cast<const char*>(buffer.data());
+        length = size;
+        return true;
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size == 0) {
+            ::close(fd);
+            base = "";
+            length = 0;
+            return true;
+        }
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        base = static_cast<const char*>(mapped);
+        length = st.st_size;
+        return true;
+#endif
+    }
+
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+};
+
+#endif // MAPPED_FILE_H
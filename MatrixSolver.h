@@ -0,0 +1,278 @@
+#ifndef MATRIX_SOLVER_H
+#define MATRIX_SOLVER_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "SearchWorkspace.h"
+#include "CostModels.h"
+#include "ContractionHierarchy.h"
+#include "LiveTraffic.h"
+#include "AllProblemsSolver.h"
+#include "ThreadPool.h"
+#include <memory>
+
+// Dense row-major matrix of route values, rows = sources, columns =
+// targets; unreachable pairs hold infinity.
+class DistanceMatrix {
+private:
+    size_t rowCount;
+    size_t colCount;
+    std::vector<double> values;
+
+public:
+    DistanceMatrix(size_t rows = 0, size_t cols = 0)
+        : rowCount(rows), colCount(cols), values(rows * cols, std::numeric_limits<double>::infinity()) {}
+
+    size_t rows() const { return rowCount; }
+    size_t cols() const { return colCount; }
+    double& at(size_t row, size_t col) { return values[row * colCount + col]; }
+    double at(size_t row, size_t col) const { return values[row * colCount + col]; }
+    double* row(size_t r) { return &values[r * colCount]; }
+
+    // One line per source; unreachable entries are written as "inf"
+    bool writeCSV(const std::string& filename) const {
+        std::ofstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << filename << std::endl;
+            return false;
+        }
+        file << std::fixed << std::setprecision(4);
+        for (size_t r = 0; r < rowCount; r++) {
+            for (size_t c = 0; c < colCount; c++) {
+                if (c > 0) file << ",";
+                double v = at(r, c);
+                if (std::isinf(v)) file << "inf";
+                else file << v;
+            }
+            file << "\n";
+        }
+        return file.good();
+    }
+
+    // "DHAKAMTX", uint64 rows, uint64 cols, then rows * cols native doubles
+    bool writeBinary(const std::string& filename) const {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << filename << std::endl;
+            return false;
+        }
+        uint64_t dims[2] = {rowCount, colCount};
+        file.write("DHAKAMTX", 8);
+        file.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+        return file.good();
+    }
+};
+
+// Origin-destination matrices under the Problem 1-3 cost models. Entries
+// equal the totalValue the matching solveProblemN would report: the
+// network cost between the snapped nodes plus the model's access cost for
+// the walks on and off. A pair that snaps to one node has no route there,
+// so it holds infinity here too.
+//
+// Each source runs one Dijkstra sweep that stops once every target node is
+// settled. For Problem 1 with a car hierarchy it uses the bucket method
+// instead: one backward upward search per target fills per-node buckets,
+// then one forward upward search per source scans them. Sources are spread
+// over the pool, one workspace per worker.
+class MatrixSolver {
+private:
+    struct BucketEntry {
+        NodeId node;
+        uint32_t target;
+        double distance;
+
+        bool operator<(const BucketEntry& other) const { return node < other.node; }
+    };
+
+    const DhakaGraph& graph;
+    const ContractionHierarchy* carHierarchy;
+    const LiveTraffic* liveTraffic;
+    ThreadPool pool;
+    std::vector<std::unique_ptr<SearchWorkspace>> workspaces;
+
+    struct Snapped {
+        std::vector<NodeId> nodes;
+        std::vector<double> walkKm;
+    };
+
+    Snapped snap(const std::vector<Location>& points) const {
+        Snapped s;
+        graph.findNearestNodes(points, s.nodes);
+        s.walkKm.resize(points.size(), 0.0);
+        for (size_t i = 0; i < points.size(); i++) {
+            if (s.nodes[i] == INVALID_NODE) continue;
+            double walk = haversineDistance(points[i], graph.getLocation(s.nodes[i]));
+            s.walkKm[i] = walk > MIN_WALK_KM ? walk : 0.0;
+        }
+        return s;
+    }
+
+    template <typename CostModel>
+    void sweep(NodeId source, const std::vector<uint8_t>& isTarget, size_t targetNodeCount,
+               const double* live, SearchWorkspace& ws) const {
+        ws.reset(graph.getLocationCount());
+        if (source == INVALID_NODE) return;
+        ws.setSource(source);
+
+        size_t remaining = targetNodeCount;
+        while (!ws.empty()) {
+            NodeId current = ws.settleNext();
+            if (isTarget[current] && --remaining == 0) break;
+
+            double currentCost = ws.distance(current);
+            for (uint32_t e = graph.edgeBegin(current); e < graph.edgeEnd(current); e++) {
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+                double w = liveEdgeCost<CostModel>(graph, live, e, mode);
+                if (std::isinf(w)) continue;
+                ws.relax(graph.edgeTarget(e), currentCost + w, current, e);
+            }
+        }
+    }
+
+    template <typename CostModel>
+    void sweepAll(const Snapped& from, const Snapped& to, const double* live, DistanceMatrix& matrix) {
+        std::vector<uint8_t> isTarget(graph.getLocationCount(), 0);
+        size_t targetNodeCount = 0;
+        for (size_t j = 0; j < to.nodes.size(); j++) {
+            if (to.nodes[j] == INVALID_NODE || isTarget[to.nodes[j]]) continue;
+            isTarget[to.nodes[j]] = 1;
+            targetNodeCount++;
+        }
+
+        pool.parallelFor(from.nodes.size(), 1, [&](size_t i, size_t worker) {
+            SearchWorkspace& ws = *workspaces[worker];
+            sweep<CostModel>(from.nodes[i], isTarget, targetNodeCount, live, ws);
+            if (from.nodes[i] == INVALID_NODE) return;
+            double* out = matrix.row(i);
+            for (size_t j = 0; j < to.nodes.size(); j++) {
+                if (to.nodes[j] == INVALID_NODE || to.nodes[j] == from.nodes[i] || !ws.isSettled(to.nodes[j])) {
+                    continue;
+                }
+                out[j] = ws.distance(to.nodes[j]) +
+                         CostModel::accessCost(from.walkKm[i]) + CostModel::accessCost(to.walkKm[j]);
+            }
+        });
+    }
+
+    void bucketAll(const ContractionHierarchy& ch, const Snapped& from, const Snapped& to, DistanceMatrix& matrix) {
+        // Backward upward searches, one per target
+        std::vector<std::vector<BucketEntry>> perTarget(to.nodes.size());
+        pool.parallelFor(to.nodes.size(), 1, [&](size_t j, size_t worker) {
+            std::vector<BucketEntry>& entries = perTarget[j];
+            auto collect = [&](NodeId node, double distance) {
+                BucketEntry entry;
+                entry.node = node;
+                entry.target = static_cast<uint32_t>(j);
+                entry.distance = distance;
+                entries.push_back(entry);
+            };
+            ch.upwardSearch(to.nodes[j], false, *workspaces[worker], collect);
+        });
+
+        std::vector<BucketEntry> buckets;
+        for (size_t j = 0; j < perTarget.size(); j++) {
+            buckets.insert(buckets.end(), perTarget[j].begin(), perTarget[j].end());
+            std::vector<BucketEntry>().swap(perTarget[j]);
+        }
+        std::stable_sort(buckets.begin(), buckets.end());
+        std::vector<uint32_t> bucketOffsets(graph.getLocationCount() + 1, 0);
+        for (size_t b = 0; b < buckets.size(); b++) {
+            bucketOffsets[buckets[b].node + 1]++;
+        }
+        for (size_t v = 0; v < graph.getLocationCount(); v++) {
+            bucketOffsets[v + 1] += bucketOffsets[v];
+        }
+
+        // Forward upward searches, one per source, scanning the buckets
+        pool.parallelFor(from.nodes.size(), 1, [&](size_t i, size_t worker) {
+            if (from.nodes[i] == INVALID_NODE) return;
+            double* out = matrix.row(i);
+            auto scan = [&](NodeId node, double distance) {
+                for (uint32_t b = bucketOffsets[node]; b < bucketOffsets[node + 1]; b++) {
+                    double total = distance + buckets[b].distance;
+                    if (total < out[buckets[b].target]) out[buckets[b].target] = total;
+                }
+            };
+            ch.upwardSearch(from.nodes[i], true, *workspaces[worker], scan);
+            for (size_t j = 0; j < to.nodes.size(); j++) {
+                if (to.nodes[j] == from.nodes[i]) out[j] = std::numeric_limits<double>::infinity();
+                if (std::isinf(out[j])) continue;
+                out[j] += CarDistanceCost::accessCost(from.walkKm[i]) + CarDistanceCost::accessCost(to.walkKm[j]);
+            }
+        });
+    }
+
+public:
+    // threads 0 means one per hardware thread; carHierarchy may be null
+    MatrixSolver(const DhakaGraph& g, size_t threads = 0, const ContractionHierarchy* ch = nullptr)
+        : graph(g), carHierarchy(ch), liveTraffic(nullptr), pool(threads) {
+        for (size_t i = 0; i < pool.size(); i++) {
+            workspaces.push_back(std::unique_ptr<SearchWorkspace>(new SearchWorkspace()));
+        }
+    }
+
+    size_t getThreadCount() const { return pool.size(); }
+
+    // When set, each matrix is computed over the traffic snapshot current
+    // when solve() starts
+    void setLiveTraffic(const LiveTraffic* traffic) { liveTraffic = traffic; }
+
+    // problem is 1, 2 or 3
+    DistanceMatrix solve(const std::vector<Location>& sources, const std::vector<Location>& targets,
+                         int problem) {
+        DistanceMatrix matrix(sources.size(), targets.size());
+        Snapped from = snap(sources);
+        Snapped to = snap(targets);
+
+        std::shared_ptr<const TrafficSnapshot> pinned;
+        if (liveTraffic != nullptr) pinned = liveTraffic->snapshot();
+        const double* live = pinned ? pinned->weights.data() : nullptr;
+        const ContractionHierarchy* ch = pinned ? pinned->carHierarchy.get() : carHierarchy;
+
+        if (problem == 1) {
+            if (ch != nullptr && ch->getMode() == TransportMode::CAR) {
+                bucketAll(*ch, from, to, matrix);
+            } else {
+                sweepAll<CarDistanceCost>(from, to, live, matrix);
+            }
+        } else if (problem == 2) {
+            sweepAll<CarMetroFareCost>(from, to, live, matrix);
+        } else {
+            sweepAll<AllModesFareCost>(from, to, live, matrix);
+        }
+        return matrix;
+    }
+
+    // One "lon,lat" point per line (further columns ignored); blank lines
+    // and # comments are skipped
+    static bool readPoints(const std::string& filename, std::vector<Location>& points) {
+        std::ifstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return false;
+        }
+
+        std::string line;
+        std::vector<CSVField> fields;
+        size_t lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            if (line.empty() || line[0] == '#' || line == "\r") continue;
+
+            CSVParser::splitFields(line.data(), line.data() + line.size(), fields);
+            Location point;
+            if (fields.size() < 2 || !CSVParser::parseDouble(fields[0], point.lon) ||
+                !CSVParser::parseDouble(fields[1], point.lat)) {
+                std::cerr << "Error: " << filename << ":" << lineNumber << ": malformed point" << std::endl;
+                return false;
+            }
+            points.push_back(point);
+        }
+        return true;
+    }
+};
+
+#endif // MATRIX_SOLVER_H
@@ -0,0 +1,114 @@
+#ifndef NODE_INTERNER_H
+#define NODE_INTERNER_H
+
+#include "DhakaRouting.h"
+#include "GraphSnapshot.h"
+
+// Coordinates are quantized to 1e-6 degree units, matching the precision of
+// the CSV inputs, so two points map to the same node iff they round to the
+// same fixed-point pair.
+const double COORD_SCALE = 1e6;
+
+inline int32_t quantizeCoord(double degrees) {
+    return static_cast<int32_t>(std::llround(degrees * COORD_SCALE));
+}
+
+inline uint64_t coordKey(const Location& loc) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(quantizeCoord(loc.lat))) << 32) |
+           static_cast<uint32_t>(quantizeCoord(loc.lon));
+}
+
+// Open-addressing (linear probing) hash from quantized coordinates to dense
+// node IDs. IDs are handed out in first-seen order and never change.
+class NodeInterner {
+private:
+    FlatArray<uint64_t> keys;
+    FlatArray<NodeId> ids;
+    uint64_t count;
+    uint64_t mask;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    void grow() {
+        size_t capacity = keys.empty() ? 1024 : keys.size() * 2;
+        std::vector<uint64_t> newKeys(capacity, 0);
+        std::vector<NodeId> newIds(capacity, INVALID_NODE);
+        size_t newMask = capacity - 1;
+
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (ids[i] == INVALID_NODE) continue;
+            size_t slot = mix(keys[i]) & newMask;
+            while (newIds[slot] != INVALID_NODE) slot = (slot + 1) & newMask;
+            newKeys[slot] = keys[i];
+            newIds[slot] = ids[i];
+        }
+
+        keys.adopt(newKeys);
+        ids.adopt(newIds);
+        mask = newMask;
+    }
+
+public:
+    NodeInterner() : count(0), mask(0) {}
+
+    void reserve(size_t nodes) {
+        while (keys.size() < nodes * 2) grow();
+    }
+
+    // Returns the existing ID for this coordinate, or assigns nextId.
+    NodeId intern(const Location& loc, NodeId nextId, bool& inserted) {
+        if ((count + 1) * 2 > keys.size()) grow();
+
+        uint64_t key = coordKey(loc);
+        size_t slot = mix(key) & mask;
+        while (ids[slot] != INVALID_NODE) {
+            if (keys[slot] == key) {
+                inserted = false;
+                return ids[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        keys[slot] = key;
+        ids[slot] = nextId;
+        count++;
+        inserted = true;
+        return nextId;
+    }
+
+    NodeId find(const Location& loc) const {
+        if (keys.empty()) return INVALID_NODE;
+
+        uint64_t key = coordKey(loc);
+        size_t slot = mix(key) & mask;
+        while (ids[slot] != INVALID_NODE) {
+            if (keys[slot] == key) return ids[slot];
+            slot = (slot + 1) & mask;
+        }
+        return INVALID_NODE;
+    }
+
+    size_t size() const { return count; }
+
+    void saveSnapshot(SnapshotWriter& writer) const {
+        writer.addArray("interner.keys", keys);
+        writer.addArray("interner.ids", ids);
+        writer.addValue("interner.count", count);
+    }
+
+    bool loadSnapshot(const SnapshotReader& reader) {
+        if (!reader.getArray("interner.keys", keys) || !reader.getArray("interner.ids", ids) ||
+            !reader.getValue("interner.count", count)) return false;
+        mask = keys.empty() ? 0 : keys.size() - 1;
+        return true;
+    }
+};
+
+#endif // NODE_INTERNER_H
@@ -0,0 +1,330 @@
+#ifndef PARETO_ROUTER_H
+#define PARETO_ROUTER_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "SearchWorkspace.h"
+#include "CostModels.h"
+
+// One route of a Pareto frontier: the graph edges taken and its three
+// criteria. A mode switch is any change of mode between consecutive edges.
+struct ParetoPath {
+    std::vector<Edge> edges;
+    double fare;
+    double distance;
+    uint32_t switches;
+
+    ParetoPath() : fare(0.0), distance(0.0), switches(0) {}
+};
+
+// Labels live in one pool and are addressed by index. Tentative labels
+// that get dominated before they are settled have no children yet, so
+// their slots go on a free list and are reused; a serial number per slot
+// lets queue entries recognise a slot that has been recycled under them.
+class LabelPool {
+public:
+    struct Label {
+        double fare;
+        double distance;
+        uint32_t switches;
+        uint32_t serial;
+        uint32_t parent;
+        uint32_t edge;
+        uint32_t nextInBag;
+        NodeId node;
+        TransportMode mode;
+        bool settled;
+    };
+
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+private:
+    std::vector<Label> labels;
+    std::vector<uint32_t> freeList;
+    uint32_t nextSerial;
+
+public:
+    LabelPool() : nextSerial(0) {}
+
+    void clear() {
+        labels.clear();
+        freeList.clear();
+    }
+
+    uint32_t allocate(const Label& label) {
+        uint32_t id;
+        if (!freeList.empty()) {
+            id = freeList.back();
+            freeList.pop_back();
+            labels[id] = label;
+        } else {
+            id = static_cast<uint32_t>(labels.size());
+            labels.push_back(label);
+        }
+        labels[id].serial = ++nextSerial;
+        return id;
+    }
+
+    void release(uint32_t id) {
+        labels[id].serial = 0;
+        freeList.push_back(id);
+    }
+
+    Label& operator[](uint32_t id) { return labels[id]; }
+    const Label& operator[](uint32_t id) const { return labels[id]; }
+
+    // Slots in use, counting released ones awaiting reuse
+    size_t capacity() const { return labels.size(); }
+};
+
+// Multi-criteria search minimising (fare, distance, mode switches) at once.
+// Labels are settled in lexicographic order (Martins' algorithm), so a
+// settled label is never dominated later and every settled destination
+// label that no earlier one dominates belongs to the frontier. Each
+// (node, arrival mode) state keeps a bag of mutually non-dominated labels.
+//
+// Pruning: a label is dropped if a frontier route dominates it even after
+// adding static lower bounds on the fare and distance still to go (from
+// two backward searches). Bags hold at most maxLabelsPerState labels and
+// routes at most maxSwitches switches; with the defaults the frontier is
+// exact on the Dhaka queries, smaller caps trade completeness for speed.
+class ParetoRouter {
+private:
+    typedef LabelPool::Label Label;
+
+    struct QueueEntry {
+        double fare;
+        double distance;
+        uint32_t switches;
+        uint32_t serial;
+        uint32_t label;
+
+        bool operator>(const QueueEntry& other) const {
+            if (fare != other.fare) return fare > other.fare;
+            if (distance != other.distance) return distance > other.distance;
+            return switches > other.switches;
+        }
+    };
+
+    const DhakaGraph& graph;
+    LabelPool pool;
+    std::vector<QueueEntry> queue;
+
+    // Bag heads and sizes per state, valid where stamp == generation
+    std::vector<uint32_t> bagHead;
+    std::vector<uint32_t> bagSize;
+    std::vector<uint32_t> stamp;
+    uint32_t generation;
+
+    SearchWorkspace fareBound;
+    SearchWorkspace distanceBound;
+    std::vector<uint32_t> frontier;
+
+    uint32_t maxLabelsPerState;
+    uint32_t maxSwitches;
+    size_t settledLabels;
+
+    // Live traffic weights pinned by the caller (null for free flow). The
+    // criteria are fare, distance and switches, so only closures matter.
+    const double* liveWeights;
+
+    bool closed(uint32_t e) const { return liveWeights != nullptr && std::isinf(liveWeights[e]); }
+
+    static bool dominates(const Label& a, double fare, double distance, uint32_t switches) {
+        return a.fare <= fare && a.distance <= distance && a.switches <= switches;
+    }
+
+    static size_t stateOf(NodeId node, TransportMode mode) {
+        return static_cast<size_t>(node) * MODE_COUNT + static_cast<size_t>(mode);
+    }
+
+    void resetStates() {
+        size_t states = graph.getLocationCount() * MODE_COUNT;
+        if (stamp.size() != states) {
+            stamp.assign(states, 0);
+            bagHead.resize(states);
+            bagSize.resize(states);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        pool.clear();
+        queue.clear();
+        frontier.clear();
+        settledLabels = 0;
+    }
+
+    void touch(size_t state) {
+        if (stamp[state] == generation) return;
+        stamp[state] = generation;
+        bagHead[state] = LabelPool::NONE;
+        bagSize[state] = 0;
+    }
+
+    // Backward static Dijkstra from the destination under one criterion
+    template <typename CostModel>
+    void computeBound(SearchWorkspace& bound, NodeId destination, bool byFare) {
+        bound.reset(graph.getLocationCount());
+        bound.setSource(destination);
+        while (!bound.empty()) {
+            NodeId current = bound.settleNext();
+            double currentCost = bound.distance(current);
+            for (uint32_t i = graph.inEdgeBegin(current); i < graph.inEdgeEnd(current); i++) {
+                uint32_t e = graph.inEdgeId(i);
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode) || closed(e)) continue;
+                double w = byFare ? CostModel::cost(graph.edgeWeight(e), mode) : graph.edgeWeight(e);
+                bound.relax(graph.inEdgeSource(i), currentCost + w, current, e);
+            }
+        }
+    }
+
+    bool dominatedByFrontier(NodeId node, double fare, double distance, uint32_t switches) const {
+        double fareLow = fare + fareBound.distance(node);
+        double distanceLow = distance + distanceBound.distance(node);
+        for (size_t i = 0; i < frontier.size(); i++) {
+            if (dominates(pool[frontier[i]], fareLow, distanceLow, switches)) return true;
+        }
+        return false;
+    }
+
+    // Adds the label to its state's bag unless something there dominates
+    // it; evicts (and recycles) the tentative labels it dominates
+    void insert(Label& candidate) {
+        if (candidate.switches > maxSwitches || !fareBound.reached(candidate.node)) return;
+        if (dominatedByFrontier(candidate.node, candidate.fare, candidate.distance, candidate.switches)) return;
+
+        size_t state = stateOf(candidate.node, candidate.mode);
+        touch(state);
+
+        uint32_t* link = &bagHead[state];
+        while (*link != LabelPool::NONE) {
+            Label& other = pool[*link];
+            if (dominates(other, candidate.fare, candidate.distance, candidate.switches)) return;
+            if (!other.settled && candidate.fare <= other.fare && candidate.distance <= other.distance &&
+                candidate.switches <= other.switches) {
+                uint32_t dead = *link;
+                *link = other.nextInBag;
+                pool.release(dead);
+                bagSize[state]--;
+                continue;
+            }
+            link = &other.nextInBag;
+        }
+        if (bagSize[state] >= maxLabelsPerState) return;
+
+        candidate.settled = false;
+        candidate.nextInBag = bagHead[state];
+        uint32_t id = pool.allocate(candidate);
+        bagHead[state] = id;
+        bagSize[state]++;
+
+        QueueEntry entry;
+        entry.fare = candidate.fare;
+        entry.distance = candidate.distance;
+        entry.switches = candidate.switches;
+        entry.serial = pool[id].serial;
+        entry.label = id;
+        queue.push_back(entry);
+        std::push_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+    }
+
+    ParetoPath extract(uint32_t labelId) const {
+        ParetoPath path;
+        const Label& last = pool[labelId];
+        path.fare = last.fare;
+        path.distance = last.distance;
+        path.switches = last.switches;
+        std::vector<uint32_t> ids;
+        for (uint32_t id = labelId; pool[id].parent != LabelPool::NONE; id = pool[id].parent) ids.push_back(id);
+        for (size_t i = ids.size(); i-- > 0;) {
+            graph.appendEdge(pool[pool[ids[i]].parent].node, pool[ids[i]].edge, path.edges);
+        }
+        return path;
+    }
+
+public:
+    static const uint32_t DEFAULT_MAX_LABELS_PER_STATE = 64;
+    static const uint32_t DEFAULT_MAX_SWITCHES = 4;
+
+    explicit ParetoRouter(const DhakaGraph& g)
+        : graph(g), generation(0), maxLabelsPerState(DEFAULT_MAX_LABELS_PER_STATE),
+          maxSwitches(DEFAULT_MAX_SWITCHES), settledLabels(0), liveWeights(nullptr) {}
+
+    void setLimits(uint32_t labelsPerState, uint32_t switches) {
+        maxLabelsPerState = std::max(1u, labelsPerState);
+        maxSwitches = switches;
+    }
+
+    // Per-edge routing weights from a pinned TrafficSnapshot, or null for
+    // free flow; must outlive every search made while set
+    void setLiveWeights(const double* weights) { liveWeights = weights; }
+
+    size_t getSettledCount() const { return settledLabels; }
+    size_t getPoolCapacity() const { return pool.capacity(); }
+
+    // The Pareto-optimal routes, cheapest first
+    template <typename CostModel>
+    std::vector<ParetoPath> frontierRoutes(NodeId source, NodeId destination) {
+        resetStates();
+        std::vector<ParetoPath> routes;
+        if (source == INVALID_NODE || destination == INVALID_NODE) return routes;
+
+        computeBound<CostModel>(fareBound, destination, true);
+        computeBound<CostModel>(distanceBound, destination, false);
+
+        Label start;
+        start.fare = 0.0;
+        start.distance = 0.0;
+        start.switches = 0;
+        start.parent = LabelPool::NONE;
+        start.edge = 0;
+        start.node = source;
+        start.mode = TransportMode::WALK;
+        insert(start);
+
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+            QueueEntry entry = queue.back();
+            queue.pop_back();
+            if (pool[entry.label].serial != entry.serial) continue;
+
+            Label& label = pool[entry.label];
+            label.settled = true;
+            settledLabels++;
+
+            if (label.node == destination) {
+                if (!dominatedByFrontier(label.node, label.fare, label.distance, label.switches)) {
+                    frontier.push_back(entry.label);
+                }
+                continue;
+            }
+
+            const Label current = label;
+            for (uint32_t e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode) || closed(e)) continue;
+
+                Label next;
+                next.fare = current.fare + CostModel::cost(graph.edgeWeight(e), mode);
+                next.distance = current.distance + graph.edgeWeight(e);
+                next.switches = current.switches +
+                                ((current.parent != LabelPool::NONE && mode != current.mode) ? 1 : 0);
+                next.parent = entry.label;
+                next.edge = e;
+                next.node = graph.edgeTarget(e);
+                next.mode = mode;
+                insert(next);
+            }
+        }
+
+        for (size_t i = 0; i < frontier.size(); i++) {
+            routes.push_back(extract(frontier[i]));
+        }
+        return routes;
+    }
+};
+
+#endif // PARETO_ROUTER_H
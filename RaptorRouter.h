@@ -0,0 +1,318 @@
+#ifndef RAPTOR_ROUTER_H
+#define RAPTOR_ROUTER_H
+
+#include "DhakaRouting.h"
+#include "TransitNetwork.h"
+#include "TimeModels.h"
+#include "TimeDependentRouter.h"
+
+// One transit journey: `trips` vehicles boarded, arriving at `arrival`
+// (minutes since midnight, including the walk off). path holds the rides
+// along their full polylines and the footpaths between them, but not the
+// walks to the first stop and from the last one.
+struct TransitJourney {
+    uint32_t trips;
+    double arrival;
+    TimedPath path;
+
+    TransitJourney() : trips(0), arrival(0.0) {}
+};
+
+// Round-based earliest-arrival search (RAPTOR) over a TransitNetwork.
+// Round k takes every route serving a stop improved in round k - 1, walks
+// it once in stop order boarding the earliest departure the schedule
+// allows, then relaxes footpaths from the stops it improved; so after
+// round k each stop holds the earliest arrival using at most k trips.
+// There is no priority queue, only scans of flat arrays. Every round that
+// improves the destination yields a journey, giving the arrival / number of
+// trips frontier in one search. Not thread-safe; use one per thread.
+class RaptorRouter {
+public:
+    static const uint32_t DEFAULT_MAX_TRANSFERS = 3;
+    static constexpr double DEFAULT_ACCESS_RADIUS_KM = 1.0;
+
+private:
+    enum class LabelKind : uint8_t { NONE, ACCESS, RIDE, WALK };
+
+    // How a stop was reached in one round. A NONE label carries the
+    // arrival over from the previous round.
+    struct Label {
+        double arrival;
+        double boardTime;   // RIDE: departure from the boarding stop
+        double walkKm;      // WALK
+        uint32_t route;     // RIDE
+        uint32_t from;      // RIDE: boarding position; WALK: source stop
+        uint32_t to;        // RIDE: alighting position
+        LabelKind kind;
+    };
+
+    const TransitNetwork* network;
+    uint32_t maxTransfers;
+    double accessRadiusKm;
+
+    std::vector<Label> labels;       // (maxTransfers + 2) rounds x stops
+    std::vector<double> best;        // earliest arrival at each stop so far
+    std::vector<double> accessKm;    // walk from the source to each stop
+    std::vector<double> egressKm;    // walk from each stop to the destination
+    std::vector<uint32_t> routeFrom; // earliest marked position per queued route
+    std::vector<uint32_t> queuedRoutes;
+    std::vector<uint8_t> marked;
+    std::vector<uint32_t> markedStops;
+    std::vector<uint32_t> nextMarked;
+    std::vector<uint32_t> rideStops;
+    std::vector<double> rideArrivals;
+    std::vector<double> legKm;
+    size_t scannedStops;
+
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+    Label& label(uint32_t round, uint32_t stop) {
+        return labels[static_cast<size_t>(round) * network->getStopCount() + stop];
+    }
+
+    static double walkMinutes(const TravelTimeModel& model, double km) {
+        return km > MIN_WALK_KM ? model.travelMinutes(km, TransportMode::WALK) : 0.0;
+    }
+
+    void mark(uint32_t stop) {
+        if (!marked[stop]) {
+            marked[stop] = 1;
+            nextMarked.push_back(stop);
+        }
+    }
+
+    void scanRoute(const TravelTimeModel& model, uint32_t r, uint32_t round, double bound) {
+        const TransitNetwork::Route& route = network->getRoute(r);
+        uint32_t boardPosition = NONE;
+        double boardTime = 0.0;
+        double boardKm = 0.0;
+        for (uint32_t p = routeFrom[r]; p < route.stopCount; p++) {
+            uint32_t stop = network->stopAt(route, p);
+            scannedStops++;
+            double onboard = std::numeric_limits<double>::infinity();
+            if (boardPosition != NONE) {
+                onboard = boardTime + model.travelMinutes(network->kmAt(route, p) - boardKm, route.mode);
+                if (onboard < best[stop] && onboard < bound) {
+                    Label& l = label(round, stop);
+                    l.arrival = onboard;
+                    l.boardTime = boardTime;
+                    l.route = r;
+                    l.from = boardPosition;
+                    l.to = p;
+                    l.kind = LabelKind::RIDE;
+                    best[stop] = onboard;
+                    if (!marked[stop]) rideStops.push_back(stop);
+                    mark(stop);
+                }
+            }
+
+            // Board here if that catches an earlier vehicle than the one
+            // we are on
+            double ready = label(round - 1, stop).arrival;
+            if (ready < onboard) {
+                double departure = model.nextDeparture(route.mode, ready);
+                if (departure < onboard) {
+                    boardPosition = p;
+                    boardTime = departure;
+                    boardKm = network->kmAt(route, p);
+                }
+            }
+        }
+    }
+
+    void appendEdge(TimedPath& path, NodeId from, NodeId to, double km, TransportMode mode, double depart,
+                    double arrive) const {
+        const DhakaGraph& graph = network->getGraph();
+        path.edges.push_back(Edge(graph.getLocation(from), graph.getLocation(to), km, mode));
+        path.departTimes.push_back(depart);
+        path.arriveTimes.push_back(arrive);
+    }
+
+    // Walks the labels back from (round, stop) and lays out the rides and
+    // footpaths in travel order. Two rides in a row get a zero-length walk
+    // between them, so the change of vehicle survives segment merging.
+    void extract(const TravelTimeModel& model, uint32_t round, uint32_t stop, TimedPath& path) {
+        std::vector<std::pair<Label, uint32_t>> legs;  // with the stop each leg reaches
+        while (true) {
+            const Label& l = label(round, stop);
+            if (l.kind == LabelKind::NONE) {
+                round--;
+                continue;
+            }
+            if (l.kind == LabelKind::ACCESS) break;
+            legs.push_back(std::make_pair(l, stop));
+            if (l.kind == LabelKind::WALK) {
+                stop = l.from;
+            } else {
+                stop = network->stopAt(network->getRoute(l.route), l.from);
+                round--;
+            }
+        }
+
+        path = TimedPath();
+        std::vector<NodeId> nodes;
+        double clock = label(round, stop).arrival;
+        for (size_t i = legs.size(); i-- > 0;) {
+            const Label& l = legs[i].first;
+            if (l.kind == LabelKind::WALK) {
+                appendEdge(path, network->getStopNode(l.from), network->getStopNode(legs[i].second), l.walkKm,
+                           TransportMode::WALK, clock, l.arrival);
+                clock = l.arrival;
+                continue;
+            }
+
+            const TransitNetwork::Route& route = network->getRoute(l.route);
+            if (!path.edges.empty() && path.edges.back().mode != TransportMode::WALK) {
+                NodeId here = network->getStopNode(network->stopAt(route, l.from));
+                appendEdge(path, here, here, 0.0, TransportMode::WALK, clock, clock);
+            }
+            // The ride's time is spread over its legs by distance, so it
+            // still ends at the label's arrival
+            network->rideNodes(route, l.from, l.to, nodes);
+            legKm.resize(nodes.size() > 0 ? nodes.size() - 1 : 0);
+            double rideKm = 0.0;
+            for (size_t n = 0; n < legKm.size(); n++) {
+                legKm[n] = network->legKm(nodes[n], nodes[n + 1], route.mode);
+                rideKm += legKm[n];
+            }
+            double depart = l.boardTime, doneKm = 0.0;
+            for (size_t n = 0; n < legKm.size(); n++) {
+                doneKm += legKm[n];
+                double arrive = rideKm > 0.0 ? l.boardTime + (l.arrival - l.boardTime) * (doneKm / rideKm) : l.arrival;
+                appendEdge(path, nodes[n], nodes[n + 1], legKm[n], route.mode, depart, arrive);
+                depart = arrive;
+            }
+            clock = l.arrival;
+        }
+
+        path.found = !path.edges.empty();
+    }
+
+public:
+    explicit RaptorRouter(const TransitNetwork* net = nullptr)
+        : network(net), maxTransfers(DEFAULT_MAX_TRANSFERS), accessRadiusKm(DEFAULT_ACCESS_RADIUS_KM),
+          scannedStops(0) {}
+
+    void setNetwork(const TransitNetwork* net) { network = net; }
+    const TransitNetwork* getNetwork() const { return network; }
+
+    // Journeys use at most maxTransfers + 1 vehicles, and start and end
+    // at stops within accessRadiusKm of the query points
+    void setLimits(uint32_t transfers, double radiusKm) {
+        maxTransfers = transfers;
+        accessRadiusKm = radiusKm;
+    }
+
+    // Stop visits made by route scans in the last search
+    size_t getScannedStops() const { return scannedStops; }
+
+    // Every journey from source to dest leaving at `departure` that no
+    // journey with fewer trips reaches as early: fewest trips first, each
+    // arriving strictly earlier than the one before
+    void search(const TravelTimeModel& model, const Location& source, const Location& dest, double departure,
+                std::vector<TransitJourney>& journeys) {
+        journeys.clear();
+        scannedStops = 0;
+        if (network == nullptr || network->empty()) return;
+
+        const double inf = std::numeric_limits<double>::infinity();
+        size_t n = network->getStopCount();
+        uint32_t rounds = maxTransfers + 2;
+        Label unreached;
+        unreached.arrival = inf;
+        unreached.boardTime = 0.0;
+        unreached.walkKm = 0.0;
+        unreached.route = unreached.from = unreached.to = NONE;
+        unreached.kind = LabelKind::NONE;
+        labels.assign(static_cast<size_t>(rounds) * n, unreached);
+        best.assign(n, inf);
+        accessKm.resize(n);
+        egressKm.resize(n);
+        GeoKernels::distancesFrom(source, network->getStopPoints(), n, accessKm.data());
+        GeoKernels::distancesFrom(dest, network->getStopPoints(), n, egressKm.data());
+        marked.assign(n, 0);
+        routeFrom.assign(network->getRouteCount(), uint32_t(NONE));
+        queuedRoutes.clear();
+        nextMarked.clear();
+
+        for (uint32_t s = 0; s < n; s++) {
+            if (accessKm[s] <= accessRadiusKm) {
+                Label& l = label(0, s);
+                l.arrival = departure + walkMinutes(model, accessKm[s]);
+                l.kind = LabelKind::ACCESS;
+                best[s] = l.arrival;
+                mark(s);
+            }
+            if (egressKm[s] > accessRadiusKm) egressKm[s] = inf;
+        }
+        markedStops.swap(nextMarked);
+
+        double target = inf;
+        for (uint32_t round = 1; round < rounds && !markedStops.empty(); round++) {
+            for (uint32_t s = 0; s < n; s++) label(round, s).arrival = label(round - 1, s).arrival;
+
+            for (size_t i = 0; i < markedStops.size(); i++) {
+                uint32_t s = markedStops[i];
+                marked[s] = 0;
+                for (uint32_t j = network->stopRoutesBegin(s); j < network->stopRoutesEnd(s); j++) {
+                    const TransitNetwork::StopRoute& entry = network->getStopRoute(j);
+                    if (routeFrom[entry.route] == NONE) {
+                        queuedRoutes.push_back(entry.route);
+                        routeFrom[entry.route] = entry.position;
+                    } else if (entry.position < routeFrom[entry.route]) {
+                        routeFrom[entry.route] = entry.position;
+                    }
+                }
+            }
+
+            rideStops.clear();
+            for (size_t i = 0; i < queuedRoutes.size(); i++) {
+                scanRoute(model, queuedRoutes[i], round, target);
+                routeFrom[queuedRoutes[i]] = NONE;
+            }
+            queuedRoutes.clear();
+
+            // One footpath after each ride, never two in a row
+            rideArrivals.resize(rideStops.size());
+            for (size_t i = 0; i < rideStops.size(); i++) rideArrivals[i] = label(round, rideStops[i]).arrival;
+            for (size_t i = 0; i < rideStops.size(); i++) {
+                uint32_t s = rideStops[i];
+                for (uint32_t f = network->footpathsBegin(s); f < network->footpathsEnd(s); f++) {
+                    uint32_t t = network->footpathTarget(f);
+                    double arrival = rideArrivals[i] + walkMinutes(model, network->footpathDistance(f));
+                    if (arrival >= best[t] || arrival >= target) continue;
+                    Label& l = label(round, t);
+                    l.arrival = arrival;
+                    l.walkKm = network->footpathDistance(f);
+                    l.from = s;
+                    l.kind = LabelKind::WALK;
+                    best[t] = arrival;
+                    mark(t);
+                }
+            }
+
+            uint32_t alight = NONE;
+            for (size_t i = 0; i < nextMarked.size(); i++) {
+                uint32_t s = nextMarked[i];
+                if (std::isinf(egressKm[s])) continue;
+                double arrival = label(round, s).arrival + walkMinutes(model, egressKm[s]);
+                if (arrival < target) {
+                    target = arrival;
+                    alight = s;
+                }
+            }
+            if (alight != NONE) {
+                journeys.push_back(TransitJourney());
+                journeys.back().trips = round;
+                journeys.back().arrival = target;
+                extract(model, round, alight, journeys.back().path);
+            }
+
+            markedStops.swap(nextMarked);
+            nextMarked.clear();
+        }
+        for (size_t i = 0; i < markedStops.size(); i++) marked[markedStops[i]] = 0;
+    }
+};
+
+#endif // RAPTOR_ROUTER_H
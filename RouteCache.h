@@ -0,0 +1,235 @@
+#ifndef ROUTE_CACHE_H
+#define ROUTE_CACHE_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+// A cached route as the graph edges it takes: the snapped source node and
+// the CSR index of every edge in order, 4 bytes per edge. An empty path
+// (no route, or both ends on one node) is cached like any other.
+struct CompactPath {
+    NodeId source;
+    std::vector<uint32_t> edges;
+
+    CompactPath() : source(INVALID_NODE) {}
+
+    // Edge IDs of a path produced by a search over this graph. Each edge is
+    // matched by endpoints, mode and weight, so parallel edges of different
+    // modes stay distinct; a chain edge must match the run of segments it
+    // expands to. Returns false if an edge is not in the graph.
+    static bool encode(const DhakaGraph& graph, NodeId source, const std::vector<Edge>& path,
+                       CompactPath& out) {
+        out.source = source;
+        out.edges.clear();
+        NodeId from = source;
+        std::vector<Edge> segments;
+        size_t i = 0;
+        while (i < path.size()) {
+            uint32_t match = graph.edgeEnd(from);
+            for (uint32_t e = graph.edgeBegin(from); e < graph.edgeEnd(from); e++) {
+                uint32_t count = graph.edgeSegmentCount(e);
+                if (graph.edgeMode(e) != path[i].mode || i + count > path.size()) continue;
+                segments.clear();
+                graph.appendEdge(from, e, segments);
+                bool same = true;
+                for (uint32_t k = 0; k < count && same; k++) {
+                    same = segments[k].end == path[i + k].end && segments[k].distance == path[i + k].distance;
+                }
+                if (same) {
+                    match = e;
+                    break;
+                }
+            }
+            if (match == graph.edgeEnd(from)) return false;
+            out.edges.push_back(match);
+            i += graph.edgeSegmentCount(match);
+            from = graph.edgeTarget(match);
+        }
+        return true;
+    }
+
+    std::vector<Edge> decode(const DhakaGraph& graph) const {
+        std::vector<Edge> path;
+        path.reserve(edges.size());
+        NodeId from = source;
+        for (size_t i = 0; i < edges.size(); i++) {
+            graph.appendEdge(from, edges[i], path);
+            from = graph.edgeTarget(edges[i]);
+        }
+        return path;
+    }
+};
+
+struct RouteCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t entries;
+    size_t bytes;
+
+    RouteCacheStats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+};
+
+// Thread-safe LRU cache of routes between snapped nodes, shared by every
+// solver over one graph. Keys are (source node, destination node, problem,
+// traffic version), so routes found under superseded live traffic are
+// never served and simply age out. Keys hash to one of a fixed set of
+// shards, each with its own lock, list and byte budget, so concurrent
+// queries rarely contend. A shard evicts its least recently used routes
+// once its share of maxBytes is exceeded.
+class RouteCache {
+public:
+    struct Key {
+        NodeId source;
+        NodeId destination;
+        uint32_t problem;
+        uint32_t trafficVersion;
+
+        bool operator==(const Key& other) const {
+            return source == other.source && destination == other.destination && problem == other.problem &&
+                   trafficVersion == other.trafficVersion;
+        }
+    };
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t h = (static_cast<uint64_t>(key.source) << 32) ^ key.destination;
+            h ^= (static_cast<uint64_t>(key.trafficVersion) << 8 | key.problem) * 0x9E3779B97F4A7C15ull;
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 33;
+            return static_cast<size_t>(h);
+        }
+    };
+
+    struct Entry {
+        Key key;
+        CompactPath path;
+        size_t bytes;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    struct Shard {
+        std::mutex mutex;
+        EntryList entries;  // most recently used first
+        std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+        size_t bytes;
+
+        Shard() : bytes(0) {}
+    };
+
+    // Approximate heap cost of one entry: list node, index node, edge IDs
+    static const size_t ENTRY_OVERHEAD = sizeof(Entry) + 4 * sizeof(void*) + sizeof(Key) + 2 * sizeof(void*);
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    size_t shardBudget;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+
+    RouteCache(const RouteCache&);
+    RouteCache& operator=(const RouteCache&);
+
+    Shard& shardOf(const Key& key) {
+        return *shards[(KeyHash()(key) >> 7) % shards.size()];
+    }
+
+public:
+    static const size_t DEFAULT_MAX_BYTES = 64u << 20;
+    static const size_t DEFAULT_SHARDS = 16;
+
+    explicit RouteCache(size_t maxBytes = DEFAULT_MAX_BYTES, size_t shardCount = DEFAULT_SHARDS)
+        : hits(0), misses(0), evictions(0) {
+        shardCount = std::max<size_t>(1, shardCount);
+        for (size_t i = 0; i < shardCount; i++) {
+            shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        }
+        shardBudget = maxBytes / shardCount;
+    }
+
+    // trafficVersion 0 is free flow (see TrafficSnapshot::version)
+    static Key makeKey(NodeId source, NodeId destination, uint32_t problem, uint32_t trafficVersion = 0) {
+        Key key;
+        key.source = source;
+        key.destination = destination;
+        key.problem = problem;
+        key.trafficVersion = trafficVersion;
+        return key;
+    }
+
+    // Copies the cached path into `path` and marks it most recently used
+    bool lookup(const Key& key, CompactPath& path) {
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) {
+            misses++;
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        path = it->second->path;
+        hits++;
+        return true;
+    }
+
+    void insert(const Key& key, const CompactPath& path) {
+        size_t bytes = ENTRY_OVERHEAD + path.edges.size() * sizeof(uint32_t);
+        Shard& shard = shardOf(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (bytes > shardBudget) return;
+
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.bytes -= it->second->bytes;
+            shard.entries.erase(it->second);
+            shard.index.erase(it);
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.path = path;
+        entry.bytes = bytes;
+        shard.entries.push_front(entry);
+        shard.index[key] = shard.entries.begin();
+        shard.bytes += bytes;
+
+        while (shard.bytes > shardBudget) {
+            Entry& oldest = shard.entries.back();
+            shard.bytes -= oldest.bytes;
+            shard.index.erase(oldest.key);
+            shard.entries.pop_back();
+            evictions++;
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i < shards.size(); i++) {
+            std::lock_guard<std::mutex> lock(shards[i]->mutex);
+            shards[i]->entries.clear();
+            shards[i]->index.clear();
+            shards[i]->bytes = 0;
+        }
+    }
+
+    RouteCacheStats getStats() const {
+        RouteCacheStats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.evictions = evictions;
+        for (size_t i = 0; i < shards.size(); i++) {
+            std::lock_guard<std::mutex> lock(shards[i]->mutex);
+            stats.entries += shards[i]->index.size();
+            stats.bytes += shards[i]->bytes;
+        }
+        return stats;
+    }
+};
+
+#endif // ROUTE_CACHE_H
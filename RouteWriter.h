@@ -0,0 +1,453 @@
+#ifndef ROUTE_WRITER_H
+#define ROUTE_WRITER_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "TimeModels.h"
+#include "AllProblemsSolver.h"
+#include <cstdio>
+
+// Formats routes as text, JSON, or full-geometry KML and GeoJSON into one
+// buffer that the caller flushes to a stream or file. The buffer keeps its
+// capacity across flushes, so writing a large batch reuses the same
+// memory; station names are read from the graph's interned table rather
+// than copied per segment.
+//
+// KML and GeoJSON documents hold any number of routes: begin, append each
+// route, end. Every segment is drawn through all of its path nodes and
+// styled by mode.
+class RouteWriter {
+private:
+    const DhakaGraph& graph;
+    std::string buffer;
+    bool firstFeature;
+
+    struct ModeStyle {
+        const char* id;
+        const char* rgb;  // RRGGBB
+        int width;
+    };
+
+    static ModeStyle styleOf(TransportMode mode) {
+        switch (mode) {
+            case TransportMode::WALK: { ModeStyle s = {"walk", "7f7f7f", 2}; return s; }
+            case TransportMode::CAR: { ModeStyle s = {"car", "d62728", 4}; return s; }
+            case TransportMode::METRO: { ModeStyle s = {"metro", "1f77b4", 5}; return s; }
+            case TransportMode::BUS_BIKOLPO: { ModeStyle s = {"bikolpo", "2ca02c", 4}; return s; }
+            case TransportMode::BUS_UTTARA:
+            default: { ModeStyle s = {"uttara", "ff7f0e", 4}; return s; }
+        }
+    }
+
+    // Degrees with 6 decimals, as %.6f would print them for coordinates
+    // (which never sit on a rounding tie), without going through printf
+    RouteWriter& appendDegrees(double value) {
+        char text[32];
+        char* end = text + sizeof(text);
+        char* p = end;
+        bool negative = value < 0;
+        uint64_t units = static_cast<uint64_t>(std::fabs(value) * 1e6 + 0.5);
+        uint64_t whole = units / 1000000;
+        uint64_t fraction = units % 1000000;
+        for (int i = 0; i < 6; i++) {
+            *--p = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        *--p = '.';
+        do {
+            *--p = static_cast<char>('0' + whole % 10);
+            whole /= 10;
+        } while (whole > 0);
+        if (negative && units > 0) *--p = '-';
+        buffer.append(p, static_cast<size_t>(end - p));
+        return *this;
+    }
+
+    // Calls visit(location) for every vertex of segment i: the query point
+    // and the node it walks to or from, or every path node of the segment
+    template <typename Visitor>
+    void forEachVertex(const CompactRoute& route, size_t i, Visitor visit) const {
+        const RouteSegment& segment = route.segments[i];
+        if (segment.from == CompactRoute::QUERY_POINT || segment.to == CompactRoute::QUERY_POINT) {
+            visit(route.segmentStart(graph, i));
+            visit(route.segmentEnd(graph, i));
+            return;
+        }
+        for (uint32_t k = segment.from; k <= segment.to; k++) {
+            visit(graph.getLocation(route.nodes[k]));
+        }
+    }
+
+    // Fill colours of the isochrone grid bands, cheapest first
+    static const char* bandColour(uint32_t band) {
+        static const char* const colours[] = {"1a9850", "91cf60", "fee08b", "fc8d59", "d73027"};
+        return colours[std::min(band, GRID_BANDS - 1)];
+    }
+
+    static uint32_t bandOf(double cost, double budget) {
+        if (!(budget > 0.0)) return 0;
+        return std::min(GRID_BANDS - 1, static_cast<uint32_t>(cost / budget * GRID_BANDS));
+    }
+
+    // Closed ring round a grid cell, as `visit` calls from the south-west
+    // corner anticlockwise
+    template <typename Visitor>
+    static void forEachCorner(const IsochroneGrid& grid, uint32_t row, uint32_t col, Visitor visit) {
+        Location low = grid.cellMin(row, col);
+        Location high = grid.cellMax(row, col);
+        visit(low);
+        visit(Location(low.lat, high.lon));
+        visit(high);
+        visit(Location(high.lat, low.lon));
+        visit(low);
+    }
+
+    RouteWriter& appendXMLText(const std::string& text) {
+        for (size_t i = 0; i < text.size(); i++) {
+            switch (text[i]) {
+                case '<': buffer += "&lt;"; break;
+                case '>': buffer += "&gt;"; break;
+                case '&': buffer += "&amp;"; break;
+                case '"': buffer += "&quot;"; break;
+                default: buffer += text[i]; break;
+            }
+        }
+        return *this;
+    }
+
+    RouteWriter& appendLocation(const Location& loc) {
+        char text[64];
+        int length = std::snprintf(text, sizeof(text), "(%.6f,%.6f)", loc.lon, loc.lat);
+        buffer.append(text, static_cast<size_t>(length));
+        return *this;
+    }
+
+    // [lon, lat] as a JSON array
+    RouteWriter& appendPosition(const Location& loc) {
+        char text[64];
+        int length = std::snprintf(text, sizeof(text), "[%.6f,%.6f]", loc.lon, loc.lat);
+        buffer.append(text, static_cast<size_t>(length));
+        return *this;
+    }
+
+    // lon,lat,0 as one KML coordinate
+    RouteWriter& appendCoordinate(const Location& loc) {
+        return appendDegrees(loc.lon).append(",").appendDegrees(loc.lat).append(",0");
+    }
+
+    RouteWriter& appendJSONString(const std::string& text) {
+        buffer += '"';
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            if (c == '"' || c == '\\') {
+                buffer += '\\';
+                buffer += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                buffer += escape;
+            } else {
+                buffer += c;
+            }
+        }
+        buffer += '"';
+        return *this;
+    }
+
+public:
+    // Buffer size at which callers writing many routes flush between them
+    static const size_t FLUSH_BYTES = 64 * 1024;
+    // Isochrone grids split the budget into this many equal cost bands
+    static const uint32_t GRID_BANDS = 5;
+
+    explicit RouteWriter(const DhakaGraph& g) : graph(g), firstFeature(true) {}
+
+    const std::string& data() const { return buffer; }
+    size_t size() const { return buffer.size(); }
+    void clear() { buffer.clear(); }
+
+    RouteWriter& append(const char* text) {
+        buffer += text;
+        return *this;
+    }
+
+    RouteWriter& append(const std::string& text) {
+        buffer += text;
+        return *this;
+    }
+
+    RouteWriter& appendFixed(double value, int precision) {
+        char text[64];
+        int length = std::snprintf(text, sizeof(text), "%.*f", precision, value);
+        buffer.append(text, static_cast<size_t>(length));
+        return *this;
+    }
+
+    RouteWriter& appendUnsigned(uint64_t value) {
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%llu", static_cast<unsigned long long>(value));
+        buffer.append(text, static_cast<size_t>(length));
+        return *this;
+    }
+
+    // Writes out and empties the buffer
+    bool flush(std::ostream& out) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+        return out.good();
+    }
+
+    bool writeFile(const std::string& filename) {
+        std::ofstream file(filename.c_str(), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot write " << filename << std::endl;
+            buffer.clear();
+            return false;
+        }
+        return flush(file);
+    }
+
+    // The console report: one block per segment, then the route's total
+    void appendText(int problem, const CompactRoute& route, bool showCost) {
+        append("Problem ").appendUnsigned(static_cast<uint64_t>(problem)).append("\n");
+        append("Source: ").appendLocation(route.source).append("\n");
+        append("Destination: ").appendLocation(route.destination).append("\n\n");
+
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            const RouteSegment& segment = route.segments[i];
+            append("Segment ").appendUnsigned(i + 1).append(": ");
+            append(transportModeToString(segment.mode)).append(" from ");
+            const std::string& startName = graph.getStationNameById(route.startNameId(graph, i));
+            if (!startName.empty()) append(startName).append(" ");
+            appendLocation(route.segmentStart(graph, i)).append(" to ");
+            const std::string& endName = graph.getStationNameById(route.endNameId(graph, i));
+            if (!endName.empty()) append(endName).append(" ");
+            appendLocation(route.segmentEnd(graph, i)).append("\n");
+
+            append("           Distance: ").appendFixed(segment.distance, 2).append(" km");
+            if (showCost) append(", Cost: Tk").appendFixed(segment.cost, 2);
+            append("\n");
+
+            if (route.isTimed()) {
+                append("           Depart: ").append(formatClock(segment.departTime));
+                append(", Arrive: ").append(formatClock(segment.arriveTime)).append("\n");
+            }
+        }
+
+        append("\n");
+        if (!route.found()) {
+            append("No route found\n");
+        } else if (route.isTimed()) {
+            double totalCost = 0.0;
+            for (size_t i = 0; i < route.segments.size(); i++) totalCost += route.segments[i].cost;
+            append("Total Cost: Tk").appendFixed(totalCost, 2).append("\n");
+            double arrival = route.segments.back().arriveTime;
+            append("Arrival: ").append(formatClock(arrival)).append(" (");
+            appendFixed(arrival - route.departure, 0).append(" min)\n");
+        } else if (showCost) {
+            append("Total Cost: Tk").appendFixed(route.totalValue, 2).append("\n");
+        } else {
+            append("Total Distance: ").appendFixed(route.totalValue, 2).append(" km\n");
+        }
+    }
+
+    // Opens a KML document with one line style per mode
+    void beginKML(const std::string& title) {
+        append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        append("<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n<Document><name>");
+        appendXMLText(title).append("</name>\n");
+        const TransportMode modes[] = {TransportMode::WALK, TransportMode::CAR, TransportMode::METRO,
+                                       TransportMode::BUS_BIKOLPO, TransportMode::BUS_UTTARA};
+        for (int m = 0; m < MODE_COUNT; m++) {
+            ModeStyle style = styleOf(modes[m]);
+            // KML colours are aabbggrr
+            append("<Style id=\"").append(style.id).append("\"><LineStyle><color>ff");
+            buffer.append(style.rgb + 4, 2).append(style.rgb + 2, 2).append(style.rgb, 2);
+            append("</color><width>").appendUnsigned(static_cast<uint64_t>(style.width));
+            append("</width></LineStyle></Style>\n");
+        }
+    }
+
+    // One folder per route, one styled placemark per segment
+    void appendKMLRoute(const CompactRoute& route, const std::string& name) {
+        append("<Folder><name>");
+        appendXMLText(name).append("</name>\n");
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            const RouteSegment& segment = route.segments[i];
+            append("<Placemark><name>").appendUnsigned(i + 1).append(". ");
+            append(transportModeToString(segment.mode)).append("</name><description>");
+            // Each end by station name where it has one, else by position
+            const std::string& startName = graph.getStationNameById(route.startNameId(graph, i));
+            if (!startName.empty()) appendXMLText(startName);
+            else appendLocation(route.segmentStart(graph, i));
+            append(" to ");
+            const std::string& endName = graph.getStationNameById(route.endNameId(graph, i));
+            if (!endName.empty()) appendXMLText(endName);
+            else appendLocation(route.segmentEnd(graph, i));
+            append(", ");
+            appendFixed(segment.distance, 2).append(" km, Tk").appendFixed(segment.cost, 2);
+            if (route.isTimed()) {
+                append(", ").append(formatClock(segment.departTime)).append("-").append(formatClock(segment.arriveTime));
+            }
+            append("</description><styleUrl>#").append(styleOf(segment.mode).id);
+            append("</styleUrl>\n<LineString><tessellate>1</tessellate><coordinates>");
+            bool first = true;
+            forEachVertex(route, i, [&](const Location& loc) {
+                if (!first) buffer += ' ';
+                first = false;
+                appendCoordinate(loc);
+            });
+            append("</coordinates></LineString></Placemark>\n");
+        }
+        append("</Folder>\n");
+    }
+
+    // Every reached cell of an isochrone grid as a square filled by cost
+    // band (fifths of the budget), in one folder after the band styles
+    void appendKMLGrid(const IsochroneGrid& grid, double budget, const std::string& name) {
+        for (uint32_t band = 0; band < GRID_BANDS; band++) {
+            const char* rgb = bandColour(band);
+            append("<Style id=\"band").appendUnsigned(band).append("\"><LineStyle><width>0</width></LineStyle>");
+            append("<PolyStyle><color>99");
+            buffer.append(rgb + 4, 2).append(rgb + 2, 2).append(rgb, 2);
+            append("</color></PolyStyle></Style>\n");
+        }
+        append("<Folder><name>");
+        appendXMLText(name).append("</name>\n");
+        for (uint32_t row = 0; row < grid.rows(); row++) {
+            for (uint32_t col = 0; col < grid.cols(); col++) {
+                double cost = grid.at(row, col);
+                if (std::isinf(cost)) continue;
+                append("<Placemark><description>").appendFixed(cost, 2);
+                append("</description><styleUrl>#band").appendUnsigned(bandOf(cost, budget));
+                append("</styleUrl><Polygon><outerBoundaryIs><LinearRing><coordinates>");
+                bool first = true;
+                forEachCorner(grid, row, col, [&](const Location& loc) {
+                    if (!first) buffer += ' ';
+                    first = false;
+                    appendCoordinate(loc);
+                });
+                append("</coordinates></LinearRing></outerBoundaryIs></Polygon></Placemark>\n");
+            }
+        }
+        append("</Folder>\n");
+    }
+
+    void endKML() {
+        append("</Document></kml>\n");
+    }
+
+    // Opens a GeoJSON FeatureCollection
+    void beginGeoJSON() {
+        append("{\"type\":\"FeatureCollection\",\"features\":[");
+        firstFeature = true;
+    }
+
+    // One LineString feature per segment; properties carry the route index,
+    // mode, distance, cost, station names, clock times and simplestyle
+    // stroke colour and width
+    void appendGeoJSONRoute(const CompactRoute& route, uint64_t routeIndex) {
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            const RouteSegment& segment = route.segments[i];
+            ModeStyle style = styleOf(segment.mode);
+            append(firstFeature ? "\n" : ",\n");
+            firstFeature = false;
+
+            append("{\"type\":\"Feature\",\"properties\":{\"route\":").appendUnsigned(routeIndex);
+            append(",\"segment\":").appendUnsigned(i);
+            append(",\"mode\":").appendJSONString(transportModeToString(segment.mode));
+            append(",\"distance_km\":").appendFixed(segment.distance, 4);
+            append(",\"cost\":").appendFixed(segment.cost, 4);
+            uint32_t startName = route.startNameId(graph, i);
+            uint32_t endName = route.endNameId(graph, i);
+            if (startName != DhakaGraph::NO_STATION_NAME) {
+                append(",\"from_name\":").appendJSONString(graph.getStationNameById(startName));
+            }
+            if (endName != DhakaGraph::NO_STATION_NAME) {
+                append(",\"to_name\":").appendJSONString(graph.getStationNameById(endName));
+            }
+            if (route.isTimed()) {
+                append(",\"depart\":").appendFixed(segment.departTime, 2);
+                append(",\"arrive\":").appendFixed(segment.arriveTime, 2);
+            }
+            append(",\"stroke\":\"#").append(style.rgb).append("\",\"stroke-width\":");
+            appendUnsigned(static_cast<uint64_t>(style.width));
+            append("},\"geometry\":{\"type\":\"LineString\",\"coordinates\":[");
+            bool first = true;
+            forEachVertex(route, i, [&](const Location& loc) {
+                append(first ? "[" : ",[");
+                first = false;
+                appendDegrees(loc.lon).append(",").appendDegrees(loc.lat).append("]");
+            });
+            append("]}}");
+        }
+    }
+
+    // One Polygon feature per reached cell of an isochrone grid; properties
+    // carry the lowest cost in the cell, its band (fifths of the budget)
+    // and simplestyle fill colour
+    void appendGeoJSONGrid(const IsochroneGrid& grid, double budget) {
+        for (uint32_t row = 0; row < grid.rows(); row++) {
+            for (uint32_t col = 0; col < grid.cols(); col++) {
+                double cost = grid.at(row, col);
+                if (std::isinf(cost)) continue;
+                uint32_t band = bandOf(cost, budget);
+                append(firstFeature ? "\n" : ",\n");
+                firstFeature = false;
+
+                append("{\"type\":\"Feature\",\"properties\":{\"cost\":").appendFixed(cost, 4);
+                append(",\"band\":").appendUnsigned(band);
+                append(",\"fill\":\"#").append(bandColour(band));
+                append("\",\"fill-opacity\":0.6,\"stroke-width\":0},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[");
+                bool first = true;
+                forEachCorner(grid, row, col, [&](const Location& loc) {
+                    append(first ? "[" : ",[");
+                    first = false;
+                    appendDegrees(loc.lon).append(",").appendDegrees(loc.lat).append("]");
+                });
+                append("]]}}");
+            }
+        }
+    }
+
+    void endGeoJSON() {
+        append("\n]}\n");
+    }
+
+    // One JSON object: found, value, total distance, the query points and
+    // each segment (mode, ends, station names, distance, cost and, when
+    // timed, clock times in minutes since midnight)
+    void appendJSON(const CompactRoute& route) {
+        append("{\"found\":").append(route.found() ? "true" : "false");
+        append(",\"value\":").appendFixed(route.totalValue, 4);
+        append(",\"distance_km\":").appendFixed(route.totalDistance(), 4);
+        append(",\"source\":").appendPosition(route.source);
+        append(",\"destination\":").appendPosition(route.destination);
+        append(",\"segments\":[");
+        for (size_t i = 0; i < route.segments.size(); i++) {
+            const RouteSegment& segment = route.segments[i];
+            if (i > 0) append(",");
+            append("{\"mode\":").appendJSONString(transportModeToString(segment.mode));
+            append(",\"from\":").appendPosition(route.segmentStart(graph, i));
+            append(",\"to\":").appendPosition(route.segmentEnd(graph, i));
+            uint32_t startName = route.startNameId(graph, i);
+            uint32_t endName = route.endNameId(graph, i);
+            if (startName != DhakaGraph::NO_STATION_NAME) {
+                append(",\"from_name\":").appendJSONString(graph.getStationNameById(startName));
+            }
+            if (endName != DhakaGraph::NO_STATION_NAME) {
+                append(",\"to_name\":").appendJSONString(graph.getStationNameById(endName));
+            }
+            append(",\"distance_km\":").appendFixed(segment.distance, 4);
+            append(",\"cost\":").appendFixed(segment.cost, 4);
+            if (route.isTimed()) {
+                append(",\"depart\":").appendFixed(segment.departTime, 2);
+                append(",\"arrive\":").appendFixed(segment.arriveTime, 2);
+            }
+            append("}");
+        }
+        append("]}");
+    }
+};
+
+#endif // ROUTE_WRITER_H
@@ -0,0 +1,623 @@
+#ifndef ROUTING_SERVER_H
+#define ROUTING_SERVER_H
+
+// Linux only: the server is built on epoll, eventfd and signalfd. Other
+// platforms get the rest of the program without --serve.
+#ifdef __linux__
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "GraphSnapshot.h"
+#include "ContractionHierarchy.h"
+#include "RouteCache.h"
+#include "AllProblemsSolver.h"
+#include "RouteWriter.h"
+#include "BatchSolver.h"
+#include "ThreadPool.h"
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Everything a query reads: the graph, its car hierarchy and a route cache
+// keyed by this graph's node IDs. Shared read-only by every request
+// dispatched while it is the server's current data.
+struct RoutingData {
+    DhakaGraph graph;
+    ContractionHierarchy carHierarchy;
+    RouteCache routeCache;
+    uint32_t generation;
+
+    RoutingData() : generation(0) {}
+
+    // Maps snapshotFile if one is given, else parses the CSVs in the
+    // working directory and builds the hierarchy; null on failure
+    static std::shared_ptr<RoutingData> load(const std::string& snapshotFile, uint32_t generation) {
+        std::shared_ptr<RoutingData> data(new RoutingData());
+        data->generation = generation;
+        if (!snapshotFile.empty()) {
+            SnapshotReader reader;
+            if (!reader.open(snapshotFile) || !data->graph.loadSnapshot(reader) ||
+                !data->carHierarchy.loadSnapshot(reader, data->graph)) {
+                return std::shared_ptr<RoutingData>();
+            }
+        } else {
+            CSVParser::buildGraph(data->graph, "Roadmap-Dhaka.csv", "Routemap-DhakaMetroRail.csv",
+                                  "Routemap-BikolpoBus.csv", "Routemap-UttaraBus.csv");
+            if (data->graph.getLocationCount() == 0) return std::shared_ptr<RoutingData>();
+            data->carHierarchy.build(data->graph, TransportMode::CAR);
+        }
+        return data;
+    }
+};
+
+// Long-running query server over a Unix domain socket or localhost TCP.
+// The protocol is line based: each request line gets one JSON response
+// line, in request order per connection, and a client may pipeline any
+// number of requests without waiting. Requests are
+//
+//   srcLon,srcLat,dstLon,dstLat,problem[,departure[,deadline]]
+//       a query as in a --batch file; the answer is the route as
+//       RouteWriter::appendJSON writes it
+//   ping     {"pong":true}
+//   stats    server counters
+//   reload   {"reloading":true,...}; the graph is reloaded in the
+//            background and swapped in once ready
+//   quit     no answer; the connection closes after the earlier answers
+//
+// Blank lines are ignored; anything else gets {"error":"..."}.
+//
+// One thread runs an epoll loop over the listening socket, the
+// connections, an eventfd the workers ring when they finish a request,
+// and a signalfd: SIGHUP reloads; SIGINT and SIGTERM stop accepting and
+// reading, finish the requests already dispatched, and return from run()
+// once their answers are delivered or DRAIN_TIMEOUT_MS passes. Queries
+// go to a fixed pool whose workers each own an AllProblemsSolver. Every query
+// carries the RoutingData current when it was read, so a reload swaps one
+// pointer: queries in flight finish on the graph they started on, and no
+// connection is dropped.
+class RoutingServer {
+public:
+    // Requests one connection may have unanswered before the server stops
+    // reading from it
+    static const size_t MAX_PENDING = 256;
+    // Longest request line accepted
+    static const size_t MAX_LINE = 4096;
+    // How long a shutdown waits for clients to take their last answers
+    // and hang up before it closes their connections anyway
+    static const int DRAIN_TIMEOUT_MS = 5000;
+
+private:
+    static const uint64_t LISTEN_TAG = 0;
+    static const uint64_t WAKE_TAG = 1;
+    static const uint64_t SIGNAL_TAG = 2;
+    static const size_t READ_CHUNK = 64 * 1024;
+
+    struct Slot {
+        std::string text;
+        bool done;
+    };
+
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t outSent;
+        std::deque<Slot> pending;  // answers in request order
+        uint64_t firstSeq;         // sequence number of pending.front()
+        bool eof;                  // the peer sent all it will; answer the rest
+        bool closing;              // quit or shutdown: take no more requests
+        bool lingering;            // answered and shut for writing; discarding input until EOF
+        uint32_t events;           // epoll interest currently registered
+
+        explicit Connection(int f)
+            : fd(f), outSent(0), firstSeq(0), eof(false), closing(false), lingering(false), events(0) {}
+
+        bool finished() const { return pending.empty() && out.empty() && (closing || (eof && in.empty())); }
+    };
+
+    struct Completion {
+        uint64_t connection;
+        uint64_t seq;
+        std::string text;
+    };
+
+    // Per-worker query state, rebuilt when a query brings newer data
+    struct Worker {
+        std::shared_ptr<RoutingData> data;
+        std::unique_ptr<AllProblemsSolver> solver;
+        std::unique_ptr<RouteWriter> writer;
+        CompactRoute route;
+    };
+
+    std::string snapshotFile;
+    std::shared_ptr<RoutingData> current;
+    // Created before the pool so every worker inherits the blocked signals
+    int signalFd;
+    ThreadPool pool;
+    std::vector<Worker> workers;
+
+    int epollFd;
+    int wakeFd;
+    int listenFd;
+    std::string unixPath;
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections;
+    uint64_t nextConnection;
+    std::vector<CSVField> fields;
+
+    std::mutex completionMutex;
+    std::vector<Completion> completions;
+    std::vector<Completion> ready;
+    std::thread loader;
+    std::shared_ptr<RoutingData> loaded;
+    bool loadDone;
+    bool reloading;
+
+    std::atomic<bool> stopRequested;
+    bool draining;
+    std::chrono::steady_clock::time_point drainDeadline;
+    size_t inFlight;
+    uint64_t requestCount;
+    uint64_t errorCount;
+
+    RoutingServer(const RoutingServer&);
+    RoutingServer& operator=(const RoutingServer&);
+
+    static int blockSignals() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGHUP);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        return signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    }
+
+    void ring() {
+        uint64_t one = 1;
+        ssize_t written = ::write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void watch(int fd, uint64_t tag, uint32_t events, int op) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epollFd, op, fd, &event);
+    }
+
+    // Runs on a pool worker
+    void execute(size_t w, uint64_t connection, uint64_t seq, const BatchQuery& query,
+                 const std::shared_ptr<RoutingData>& data) {
+        Worker& worker = workers[w];
+        if (worker.data != data) {
+            worker.solver.reset(new AllProblemsSolver(data->graph));
+            worker.solver->setCarHierarchy(&data->carHierarchy);
+            worker.solver->setRouteCache(&data->routeCache);
+            worker.writer.reset(new RouteWriter(data->graph));
+            worker.data = data;
+        }
+        worker.solver->solveRoute(query.problem, query.source, query.destination, worker.route,
+                                  query.departure, query.deadline);
+        worker.writer->clear();
+        worker.writer->appendJSON(worker.route);
+
+        Completion done;
+        done.connection = connection;
+        done.seq = seq;
+        done.text = worker.writer->data();
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            completions.push_back(std::move(done));
+        }
+        ring();
+    }
+
+    void answer(Connection& c, const std::string& text) {
+        Slot slot;
+        slot.text = text;
+        slot.done = true;
+        c.pending.push_back(slot);
+    }
+
+    std::string statsJSON() const {
+        std::ostringstream out;
+        out << "{\"generation\":" << current->generation << ",\"connections\":" << connections.size()
+            << ",\"requests\":" << requestCount << ",\"errors\":" << errorCount << ",\"in_flight\":" << inFlight
+            << ",\"reloading\":" << (reloading ? "true" : "false") << "}";
+        return out.str();
+    }
+
+    void handleLine(uint64_t id, Connection& c, const char* begin, const char* end) {
+        if (end != begin && end[-1] == '\r') end--;
+        if (begin == end) return;
+        std::string word(begin, end);
+        if (word == "quit") {
+            c.closing = true;
+            return;
+        }
+        requestCount++;
+        if (word == "ping") {
+            answer(c, "{\"pong\":true}");
+        } else if (word == "stats") {
+            answer(c, statsJSON());
+        } else if (word == "reload") {
+            startReload();
+            answer(c, "{\"reloading\":true,\"generation\":" + std::to_string(current->generation) + "}");
+        } else {
+            BatchQuery query;
+            CSVParser::splitFields(begin, end, fields);
+            if (!BatchSolver::parseQuery(fields, query)) {
+                errorCount++;
+                answer(c, "{\"error\":\"malformed request\"}");
+                return;
+            }
+            uint64_t seq = c.firstSeq + c.pending.size();
+            Slot slot;
+            slot.done = false;
+            c.pending.push_back(slot);
+            inFlight++;
+            std::shared_ptr<RoutingData> data = current;
+            pool.submit([this, id, seq, query, data](size_t worker) { execute(worker, id, seq, query, data); });
+        }
+    }
+
+    // Answers or dispatches every complete line (and, after EOF, a last
+    // unterminated one), up to MAX_PENDING open requests; the rest wait in
+    // the input buffer
+    void parseLines(uint64_t id, Connection& c) {
+        size_t start = 0;
+        while (!c.closing && c.pending.size() < MAX_PENDING && start < c.in.size()) {
+            size_t newline = c.in.find('\n', start);
+            if (newline == std::string::npos && !c.eof) break;
+            if (newline == std::string::npos) newline = c.in.size();
+            if (newline - start > MAX_LINE) break;
+            handleLine(id, c, c.in.data() + start, c.in.data() + newline);
+            start = std::min(newline + 1, c.in.size());
+        }
+        c.in.erase(0, start);
+        if (c.in.size() > MAX_LINE && c.in.find('\n') > MAX_LINE) {
+            errorCount++;
+            answer(c, "{\"error\":\"request line too long\"}");
+            c.closing = true;
+        }
+        if (c.closing) c.in.clear();
+    }
+
+    // Moves finished answers at the head of the queue to the output and
+    // writes what the socket takes; false if the connection failed
+    bool flush(Connection& c) {
+        while (!c.pending.empty() && c.pending.front().done) {
+            c.out += c.pending.front().text;
+            c.out += '\n';
+            c.pending.pop_front();
+            c.firstSeq++;
+        }
+        while (c.outSent < c.out.size()) {
+            ssize_t sent = ::send(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent, MSG_NOSIGNAL);
+            if (sent > 0) {
+                c.outSent += static_cast<size_t>(sent);
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        if (c.outSent == c.out.size()) {
+            c.out.clear();
+            c.outSent = 0;
+        }
+        return true;
+    }
+
+    void closeConnection(uint64_t id) {
+        auto it = connections.find(id);
+        if (it == connections.end()) return;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second->fd, nullptr);
+        ::close(it->second->fd);
+        connections.erase(it);
+    }
+
+    // Flushes, parses input held back by a full queue now that answers
+    // have left it, then closes the connection or sets its epoll interest
+    // to match its state
+    void update(uint64_t id, Connection& c) {
+        if (!flush(c)) {
+            closeConnection(id);
+            return;
+        }
+        if (!c.in.empty() && c.pending.size() < MAX_PENDING) {
+            parseLines(id, c);
+            if (!flush(c)) {
+                closeConnection(id);
+                return;
+            }
+        }
+        if (c.finished()) {
+            if (!c.closing || c.eof) {
+                closeConnection(id);
+                return;
+            }
+            // The peer may still be sending. Closing with its input unread
+            // would reset the connection and could lose the last answers,
+            // so shut our side and read until it hangs up.
+            if (!c.lingering) {
+                ::shutdown(c.fd, SHUT_WR);
+                c.lingering = true;
+            }
+        }
+        uint32_t events = 0;
+        if (!c.eof && (c.lingering || (!c.closing && c.pending.size() < MAX_PENDING))) events |= EPOLLIN;
+        if (!c.out.empty()) events |= EPOLLOUT;
+        if (events != c.events) {
+            watch(c.fd, id, events, EPOLL_CTL_MOD);
+            c.events = events;
+        }
+    }
+
+    void readFrom(uint64_t id, Connection& c) {
+        char buffer[READ_CHUNK];
+        while (c.in.size() < MAX_PENDING * 64 + MAX_LINE) {
+            ssize_t count = ::read(c.fd, buffer, sizeof(buffer));
+            if (count > 0) {
+                c.in.append(buffer, static_cast<size_t>(count));
+            } else if (count == 0) {
+                c.eof = true;
+                break;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            } else {
+                closeConnection(id);
+                return;
+            }
+        }
+        update(id, c);
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            if (unixPath.empty()) {
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            uint64_t id = nextConnection++;
+            Connection* c = new Connection(fd);
+            c->events = EPOLLIN;
+            connections[id].reset(c);
+            watch(fd, id, EPOLLIN, EPOLL_CTL_ADD);
+        }
+    }
+
+    void startReload() {
+        if (reloading || draining) return;
+        reloading = true;
+        uint32_t generation = current->generation + 1;
+        std::cout << "Reloading graph (generation " << generation << ")..." << std::endl;
+        loader = std::thread([this, generation] {
+            std::shared_ptr<RoutingData> data = RoutingData::load(snapshotFile, generation);
+            {
+                std::lock_guard<std::mutex> lock(completionMutex);
+                loaded = data;
+                loadDone = true;
+            }
+            ring();
+        });
+    }
+
+    void processCompletions() {
+        uint64_t counter;
+        while (::read(wakeFd, &counter, sizeof(counter)) > 0) {}
+
+        bool reloaded = false;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            ready.swap(completions);
+            if (loadDone) {
+                reloaded = true;
+                loadDone = false;
+            }
+        }
+
+        for (size_t i = 0; i < ready.size(); i++) {
+            inFlight--;
+            auto it = connections.find(ready[i].connection);
+            if (it == connections.end()) continue;
+            Slot& slot = it->second->pending[ready[i].seq - it->second->firstSeq];
+            slot.text.swap(ready[i].text);
+            slot.done = true;
+        }
+        for (size_t i = 0; i < ready.size(); i++) {
+            auto it = connections.find(ready[i].connection);
+            if (it != connections.end()) update(it->first, *it->second);
+        }
+        ready.clear();
+
+        if (reloaded) {
+            loader.join();
+            reloading = false;
+            if (loaded) {
+                current = loaded;
+                std::cout << "  ✓ Generation " << current->generation << " serving: "
+                          << current->graph.getLocationCount() << " locations, "
+                          << current->graph.getEdgeCount() << " edges" << std::endl;
+            } else {
+                std::cerr << "Error: Reload failed; generation " << current->generation << " keeps serving"
+                          << std::endl;
+            }
+            loaded.reset();
+        }
+    }
+
+    void beginDrain() {
+        draining = true;
+        drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DRAIN_TIMEOUT_MS);
+        if (listenFd >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, listenFd, nullptr);
+            ::close(listenFd);
+            listenFd = -1;
+        }
+        std::vector<uint64_t> ids;
+        for (auto it = connections.begin(); it != connections.end(); ++it) ids.push_back(it->first);
+        for (size_t i = 0; i < ids.size(); i++) {
+            Connection& c = *connections[ids[i]];
+            c.closing = true;
+            c.in.clear();
+            update(ids[i], c);
+        }
+    }
+
+public:
+    // threads 0 means one per hardware thread. snapshotFile is what reload
+    // reads (the CSVs if empty).
+    RoutingServer(const std::shared_ptr<RoutingData>& data, const std::string& snapshot, size_t threads = 0)
+        : snapshotFile(snapshot), current(data), signalFd(blockSignals()), pool(threads),
+          workers(pool.size()), epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          listenFd(-1), nextConnection(SIGNAL_TAG + 1), loadDone(false), reloading(false), stopRequested(false),
+          draining(false), inFlight(0), requestCount(0), errorCount(0) {
+        watch(wakeFd, WAKE_TAG, EPOLLIN, EPOLL_CTL_ADD);
+        if (signalFd >= 0) watch(signalFd, SIGNAL_TAG, EPOLLIN, EPOLL_CTL_ADD);
+    }
+
+    ~RoutingServer() {
+        if (loader.joinable()) loader.join();
+        for (auto it = connections.begin(); it != connections.end(); ++it) ::close(it->second->fd);
+        if (listenFd >= 0) ::close(listenFd);
+        if (!unixPath.empty()) ::unlink(unixPath.c_str());
+        ::close(wakeFd);
+        ::close(epollFd);
+        if (signalFd >= 0) ::close(signalFd);
+    }
+
+    size_t getThreadCount() const { return pool.size(); }
+
+    // "unix:PATH" (a stale socket file there is replaced) or "tcp:PORT" on
+    // 127.0.0.1
+    bool listen(const std::string& address) {
+        if (address.compare(0, 5, "unix:") == 0) {
+            std::string path = address.substr(5);
+            struct sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                std::cerr << "Error: Bad socket path " << path << std::endl;
+                return false;
+            }
+            std::memcpy(addr.sun_path, path.c_str(), path.size());
+            listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            ::unlink(path.c_str());
+            if (listenFd < 0 || bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+                std::cerr << "Error: Cannot bind " << path << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            unixPath = path;
+        } else if (address.compare(0, 4, "tcp:") == 0) {
+            int port = std::atoi(address.c_str() + 4);
+            struct sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(port));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int one = 1;
+            if (listenFd >= 0) setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (port <= 0 || port > 65535 || listenFd < 0 ||
+                bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+                std::cerr << "Error: Cannot bind " << address << ": " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Error: Address must be unix:PATH or tcp:PORT" << std::endl;
+            return false;
+        }
+        if (::listen(listenFd, SOMAXCONN) != 0) {
+            std::cerr << "Error: Cannot listen on " << address << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        watch(listenFd, LISTEN_TAG, EPOLLIN, EPOLL_CTL_ADD);
+        return true;
+    }
+
+    // Safe from any thread: run() drains and returns
+    void stop() {
+        stopRequested = true;
+        ring();
+    }
+
+    // Serves until stopped by stop(), SIGINT or SIGTERM; answers every
+    // request already read before returning
+    void run() {
+        struct epoll_event events[64];
+        while (true) {
+            if (stopRequested && !draining) beginDrain();
+            int timeout = -1;
+            if (draining) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    drainDeadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0) {
+                    while (!connections.empty()) closeConnection(connections.begin()->first);
+                } else {
+                    timeout = static_cast<int>(left.count());
+                }
+                if (inFlight == 0 && connections.empty() && !reloading) break;
+            }
+
+            int count = epoll_wait(epollFd, events, 64, timeout);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Error: epoll_wait: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == LISTEN_TAG) {
+                    acceptAll();
+                } else if (tag == WAKE_TAG) {
+                    processCompletions();
+                } else if (tag == SIGNAL_TAG) {
+                    struct signalfd_siginfo info;
+                    while (::read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+                        if (info.ssi_signo == SIGHUP) startReload();
+                        else stopRequested = true;
+                    }
+                } else {
+                    auto it = connections.find(tag);
+                    if (it == connections.end()) continue;
+                    Connection& c = *it->second;
+                    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                        readFrom(tag, c);
+                    } else if (events[i].events & EPOLLOUT) {
+                        update(tag, c);
+                    }
+                }
+            }
+        }
+        if (loader.joinable()) loader.join();
+        pool.wait();
+    }
+};
+
+#endif // __linux__
+
+#endif // ROUTING_SERVER_H
@@ -0,0 +1,189 @@
+#ifndef SEARCH_WORKSPACE_H
+#define SEARCH_WORKSPACE_H
+
+#include "DhakaRouting.h"
+#include "Instrumentation.h"
+
+// Min-heap of node IDs keyed by double, with decrease-key. position[] maps a
+// node to its slot in the heap and is only meaningful while the node is
+// queued; the owner tracks that (see SearchWorkspace).
+template <unsigned Arity>
+class IndexedDaryHeap {
+private:
+    std::vector<NodeId> nodes;
+    std::vector<double> keys;
+    std::vector<uint32_t> position;
+    uint32_t count;
+
+    void place(uint32_t slot, NodeId node, double key) {
+        nodes[slot] = node;
+        keys[slot] = key;
+        position[node] = slot;
+    }
+
+    void siftUp(uint32_t slot, NodeId node, double key) {
+        while (slot > 0) {
+            uint32_t parent = (slot - 1) / Arity;
+            if (keys[parent] <= key) break;
+            place(slot, nodes[parent], keys[parent]);
+            slot = parent;
+        }
+        place(slot, node, key);
+    }
+
+    void siftDown(uint32_t slot, NodeId node, double key) {
+        while (true) {
+            uint32_t first = slot * Arity + 1;
+            if (first >= count) break;
+            uint32_t last = std::min(first + Arity, count);
+            uint32_t best = first;
+            for (uint32_t c = first + 1; c < last; c++) {
+                if (keys[c] < keys[best]) best = c;
+            }
+            if (keys[best] >= key) break;
+            place(slot, nodes[best], keys[best]);
+            slot = best;
+        }
+        place(slot, node, key);
+    }
+
+public:
+    IndexedDaryHeap() : count(0) {}
+
+    // Sizes every array for nodeCount nodes so pushes never allocate
+    void resize(size_t nodeCount) {
+        nodes.resize(nodeCount);
+        keys.resize(nodeCount);
+        position.resize(nodeCount);
+        count = 0;
+    }
+
+    void clear() { count = 0; }
+    bool empty() const { return count == 0; }
+    uint32_t size() const { return count; }
+    double topKey() const { return keys[0]; }
+    NodeId top() const { return nodes[0]; }
+
+    void push(NodeId node, double key) {
+        siftUp(count++, node, key);
+    }
+
+    void decreaseKey(NodeId node, double key) {
+        siftUp(position[node], node, key);
+    }
+
+    NodeId pop() {
+        NodeId result = nodes[0];
+        count--;
+        if (count > 0) siftDown(0, nodes[count], keys[count]);
+        return result;
+    }
+};
+
+// Per-thread Dijkstra state: flat distance/parent arrays sized to the node
+// count and an indexed 4-ary heap. A node's entries are valid only if its
+// stamp equals the current generation, so reset() is O(1) and repeated
+// searches do no heap allocation.
+class SearchWorkspace {
+private:
+    std::vector<double> dist;
+    std::vector<NodeId> parent;
+    std::vector<uint32_t> parentEdge;
+    std::vector<uint32_t> stamp;
+    std::vector<uint8_t> settled;
+    IndexedDaryHeap<4> heap;
+    uint32_t generation;
+    // Heap operations since clearCounters(); survive reset() so one query
+    // can sum several searches
+    size_t heapPushes;
+    size_t heapPops;
+
+public:
+    SearchWorkspace() : generation(0), heapPushes(0), heapPops(0) {}
+
+    void reset(size_t nodeCount) {
+        if (stamp.size() != nodeCount) {
+            dist.resize(nodeCount);
+            parent.resize(nodeCount);
+            parentEdge.resize(nodeCount);
+            settled.resize(nodeCount);
+            stamp.assign(nodeCount, 0);
+            heap.resize(nodeCount);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        heap.clear();
+    }
+
+    size_t nodeCount() const { return stamp.size(); }
+
+    void clearCounters() {
+        heapPushes = 0;
+        heapPops = 0;
+    }
+    size_t getHeapPushes() const { return heapPushes; }
+    size_t getHeapPops() const { return heapPops; }
+
+    bool reached(NodeId node) const { return stamp[node] == generation; }
+    bool isSettled(NodeId node) const { return reached(node) && settled[node]; }
+
+    double distance(NodeId node) const {
+        return reached(node) ? dist[node] : std::numeric_limits<double>::infinity();
+    }
+
+    NodeId parentOf(NodeId node) const { return reached(node) ? parent[node] : INVALID_NODE; }
+    uint32_t parentEdgeOf(NodeId node) const { return parentEdge[node]; }
+
+    void setSource(NodeId node, double d = 0.0) {
+        relax(node, d, INVALID_NODE, 0);
+    }
+
+    void setSource(NodeId node, double d, double priority) {
+        relax(node, d, INVALID_NODE, 0, priority);
+    }
+
+    // Records a tentative distance and queues or decrease-keys the node.
+    // Returns false if d does not improve on the node's current label.
+    bool relax(NodeId node, double d, NodeId from, uint32_t edge) {
+        return relax(node, d, from, edge, d);
+    }
+
+    // As above, but orders the heap by `priority` (d plus a potential, for
+    // goal-directed searches) instead of by d itself.
+    bool relax(NodeId node, double d, NodeId from, uint32_t edge, double priority) {
+        if (!reached(node)) {
+            stamp[node] = generation;
+            settled[node] = 0;
+            dist[node] = d;
+            parent[node] = from;
+            parentEdge[node] = edge;
+            heap.push(node, priority);
+            DHAKA_COUNT(heapPushes, 1);
+            return true;
+        }
+        if (settled[node] || d >= dist[node]) return false;
+
+        dist[node] = d;
+        parent[node] = from;
+        parentEdge[node] = edge;
+        heap.decreaseKey(node, priority);
+        return true;
+    }
+
+    bool empty() const { return heap.empty(); }
+    double minKey() const { return heap.topKey(); }
+    NodeId peek() const { return heap.top(); }
+
+    // Pops and settles the closest queued node
+    NodeId settleNext() {
+        NodeId node = heap.pop();
+        settled[node] = 1;
+        DHAKA_COUNT(heapPops, 1);
+        return node;
+    }
+};
+
+#endif // SEARCH_WORKSPACE_H
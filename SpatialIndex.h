@@ -0,0 +1,412 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "DhakaRouting.h"
+#include "GraphSnapshot.h"
+#include "GeoKernels.h"
+
+// Uniform lat/lon grid over the node set. Cells are stored CSR-style
+// (cellOffsets/cellNodes) with node IDs ascending inside each cell. Queries
+// scan rings of cells outward, skip cells whose bounding box cannot beat the
+// current best, and stop once a conservative lower bound on the next ring
+// exceeds it, so they return exactly what a linear haversine scan would
+// (ties go to the lowest node ID).
+class SpatialIndex {
+private:
+    double minLat, minLon;
+    double cellLat, cellLon;
+    int rows, cols;
+    double maxAbsLat;
+
+    FlatArray<uint32_t> cellOffsets;
+    FlatArray<NodeId> cellNodes;
+    FlatArray<double> latRad;
+    FlatArray<double> lonRad;
+    FlatArray<double> cosLat;
+
+    // Grid geometry, stored as one snapshot section
+    struct GridParams {
+        double minLat, minLon;
+        double cellLat, cellLon;
+        double maxAbsLat;
+        int32_t rows, cols;
+    };
+
+    struct Candidate {
+        double dist;
+        NodeId node;
+
+        Candidate(double d, NodeId n) : dist(d), node(n) {}
+
+        bool operator<(const Candidate& other) const {
+            if (dist != other.dist) return dist < other.dist;
+            return node < other.node;
+        }
+    };
+
+    int rowOf(double lat) const {
+        return static_cast<int>(std::floor((lat - minLat) / cellLat));
+    }
+
+    int colOf(double lon) const {
+        return static_cast<int>(std::floor((lon - minLon) / cellLon));
+    }
+
+    // No node in a cell whose row or column differs from the query's by at
+    // least `ring` can be closer than this. rowFrac/colFrac are the query's
+    // position inside its own cell, in [0, 1).
+    double ringLowerBound(int ring, double targetLat, double rowFrac, double colFrac) const {
+        if (ring == 0) return 0.0;
+        double latGap = toRadians((ring - 1 + std::min(rowFrac, 1 - rowFrac)) * cellLat);
+        double lonGap = toRadians((ring - 1 + std::min(colFrac, 1 - colFrac)) * cellLon);
+        double cosMax = std::cos(toRadians(std::max(maxAbsLat, std::abs(targetLat))));
+        double latBound = EARTH_RADIUS_KM * latGap;
+        double lonBound = 2 * EARTH_RADIUS_KM * std::asin(std::min(1.0, cosMax * std::sin(lonGap / 2)));
+        return std::min(latBound, lonBound);
+    }
+
+    struct QueryCell {
+        int row, col, lastRing;
+        double rowFrac, colFrac;
+    };
+
+    QueryCell locate(const Location& target) const {
+        QueryCell q;
+        double y = (target.lat - minLat) / cellLat;
+        double x = (target.lon - minLon) / cellLon;
+        q.row = static_cast<int>(std::floor(y));
+        q.col = static_cast<int>(std::floor(x));
+        q.rowFrac = y - q.row;
+        q.colFrac = x - q.col;
+        q.lastRing = maxRing(q.row, q.col);
+        return q;
+    }
+
+    int maxRing(int row, int col) const {
+        int r = std::max(std::abs(row), std::abs(row - (rows - 1)));
+        int c = std::max(std::abs(col), std::abs(col - (cols - 1)));
+        return std::max(r, c);
+    }
+
+    template <typename Visitor>
+    void visitCell(int row, int col, Visitor& visit) const {
+        if (row < 0 || row >= rows || col < 0 || col >= cols) return;
+        size_t cell = static_cast<size_t>(row) * cols + col;
+        if (cellOffsets[cell] == cellOffsets[cell + 1] || !visit.mayContainCloser(row, col)) return;
+        for (uint32_t i = cellOffsets[cell]; i < cellOffsets[cell + 1]; i++) {
+            visit(cellNodes[i]);
+        }
+    }
+
+    template <typename Visitor>
+    void visitRing(int row, int col, int ring, Visitor& visit) const {
+        if (ring == 0) {
+            visitCell(row, col, visit);
+            return;
+        }
+        int top = row + ring, bottom = row - ring;
+        int c0 = std::max(col - ring, 0), c1 = std::min(col + ring, cols - 1);
+        for (int c = c0; c <= c1; c++) {
+            visitCell(bottom, c, visit);
+            visitCell(top, c, visit);
+        }
+        int r0 = std::max(bottom + 1, 0), r1 = std::min(top - 1, rows - 1);
+        for (int r = r0; r <= r1; r++) {
+            visitCell(r, col - ring, visit);
+            visitCell(r, col + ring, visit);
+        }
+    }
+
+    // Lower bound on the haversine term between the query and any point of
+    // a cell, from the gaps between the query and the cell's edges:
+    // a >= sin^2(dlat/2) + cos^2(maxLat) * sin^2(dlon/2).
+    struct CellBound {
+        const SpatialIndex& index;
+        double lat, lon;
+        double cosMaxSq;
+
+        CellBound(const SpatialIndex& idx, const Location& target)
+            : index(idx), lat(target.lat), lon(target.lon) {
+            double cosMax = std::cos(toRadians(std::max(idx.maxAbsLat, std::abs(target.lat))));
+            cosMaxSq = cosMax * cosMax;
+        }
+
+        double term(int row, int col) const {
+            double cellMinLat = index.minLat + row * index.cellLat;
+            double cellMinLon = index.minLon + col * index.cellLon;
+            double dlat = std::max(0.0, std::max(cellMinLat - lat, lat - (cellMinLat + index.cellLat)));
+            double dlon = std::max(0.0, std::max(cellMinLon - lon, lon - (cellMinLon + index.cellLon)));
+            double sLat = std::sin(toRadians(dlat) / 2);
+            double sLon = std::sin(toRadians(dlon) / 2);
+            return sLat * sLat + cosMaxSq * sLon * sLon;
+        }
+    };
+
+    struct KNearestVisitor {
+        const SpatialIndex& index;
+        CellBound bound;
+        double lat, lon, cosTarget;
+        size_t k;
+        std::vector<Candidate>& heap;
+
+        KNearestVisitor(const SpatialIndex& idx, const Location& target, size_t count,
+                        std::vector<Candidate>& h)
+            : index(idx), bound(idx, target), lat(toRadians(target.lat)), lon(toRadians(target.lon)),
+              cosTarget(std::cos(lat)), k(count), heap(h) {}
+
+        bool mayContainCloser(int row, int col) const {
+            return heap.size() < k || haversineFromTerm(bound.term(row, col)) <= heap.front().dist;
+        }
+
+        void operator()(NodeId node) {
+            Candidate cand(haversineFromTerm(haversineTerm(lat, lon, cosTarget, index.latRad[node],
+                                                           index.lonRad[node], index.cosLat[node])),
+                           node);
+            if (heap.size() < k) {
+                heap.push_back(cand);
+                std::push_heap(heap.begin(), heap.end());
+            } else if (cand < heap.front()) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = cand;
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+    };
+
+    struct NearestVisitor {
+        const SpatialIndex& index;
+        CellBound bound;
+        double lat, lon, cosTarget;
+        double bestTerm;
+        NodeId best;
+
+        NearestVisitor(const SpatialIndex& idx, const Location& target)
+            : index(idx), bound(idx, target), lat(toRadians(target.lat)), lon(toRadians(target.lon)),
+              cosTarget(std::cos(lat)), bestTerm(std::numeric_limits<double>::max()), best(INVALID_NODE) {}
+
+        bool mayContainCloser(int row, int col) const {
+            return best == INVALID_NODE || bound.term(row, col) <= bestTerm;
+        }
+
+        void operator()(NodeId node) {
+            double a = haversineTerm(lat, lon, cosTarget,
+                                     index.latRad[node], index.lonRad[node], index.cosLat[node]);
+            if (a < bestTerm || (a == bestTerm && node < best)) {
+                bestTerm = a;
+                best = node;
+            }
+        }
+    };
+
+    struct RadiusVisitor {
+        const SpatialIndex& index;
+        CellBound bound;
+        double lat, lon, cosTarget, radiusKm;
+        std::vector<Candidate>& found;
+
+        RadiusVisitor(const SpatialIndex& idx, const Location& target, double radius,
+                      std::vector<Candidate>& f)
+            : index(idx), bound(idx, target), lat(toRadians(target.lat)), lon(toRadians(target.lon)),
+              cosTarget(std::cos(lat)), radiusKm(radius), found(f) {}
+
+        bool mayContainCloser(int row, int col) const {
+            return haversineFromTerm(bound.term(row, col)) <= radiusKm;
+        }
+
+        void operator()(NodeId node) {
+            double dist = haversineRadians(lat, lon, cosTarget,
+                                           index.latRad[node], index.lonRad[node], index.cosLat[node]);
+            if (dist <= radiusKm) found.push_back(Candidate(dist, node));
+        }
+    };
+
+public:
+    SpatialIndex() : minLat(0), minLon(0), cellLat(1), cellLon(1), rows(0), cols(0), maxAbsLat(0) {}
+
+    // Nodes flagged in `skip` keep their coordinates (for distanceBetween
+    // and points()) but are never returned by a query
+    void build(const FlatArray<double>& lat, const FlatArray<double>& lon,
+               double nodesPerCell = 2.0, const std::vector<uint8_t>* skip = nullptr) {
+        size_t n = lat.size();
+        latRad.resize(n);
+        lonRad.resize(n);
+        cosLat.resize(n);
+        cellNodes.clear();
+        cellOffsets.clear();
+        rows = cols = 0;
+        if (n == 0) return;
+
+        double maxLat = lat[0], maxLon = lon[0];
+        minLat = lat[0];
+        minLon = lon[0];
+        for (size_t i = 0; i < n; i++) {
+            minLat = std::min(minLat, lat[i]);
+            maxLat = std::max(maxLat, lat[i]);
+            minLon = std::min(minLon, lon[i]);
+            maxLon = std::max(maxLon, lon[i]);
+            latRad[i] = toRadians(lat[i]);
+            lonRad[i] = toRadians(lon[i]);
+            cosLat[i] = std::cos(latRad[i]);
+        }
+        maxAbsLat = std::max(std::abs(minLat), std::abs(maxLat));
+
+        // Roughly square cells in ground distance
+        double spanLat = std::max(maxLat - minLat, 1e-6);
+        double spanLon = std::max(maxLon - minLon, 1e-6);
+        double lonScale = std::cos(toRadians((minLat + maxLat) / 2));
+        size_t indexed = n;
+        if (skip != nullptr) indexed -= std::count(skip->begin(), skip->end(), 1);
+        double cells = std::max(1.0, indexed / nodesPerCell);
+        double side = std::sqrt(spanLat * spanLon * lonScale / cells);
+        rows = std::max(1, static_cast<int>(std::ceil(spanLat / side)));
+        cols = std::max(1, static_cast<int>(std::ceil(spanLon * lonScale / side)));
+        cellLat = spanLat / rows * (1 + 1e-9);
+        cellLon = spanLon / cols * (1 + 1e-9);
+
+        size_t cellCount = static_cast<size_t>(rows) * cols;
+        std::vector<uint32_t> cellOf(n);
+        cellOffsets.assign(cellCount + 1, 0);
+        for (size_t i = 0; i < n; i++) {
+            if (skip != nullptr && (*skip)[i]) continue;
+            int r = std::min(std::max(rowOf(lat[i]), 0), rows - 1);
+            int c = std::min(std::max(colOf(lon[i]), 0), cols - 1);
+            cellOf[i] = static_cast<uint32_t>(r) * cols + c;
+            cellOffsets[cellOf[i] + 1]++;
+        }
+        for (size_t c = 0; c < cellCount; c++) {
+            cellOffsets[c + 1] += cellOffsets[c];
+        }
+        cellNodes.resize(indexed);
+        std::vector<uint32_t> cursor(cellOffsets.begin(), cellOffsets.end() - 1);
+        for (size_t i = 0; i < n; i++) {
+            if (skip != nullptr && (*skip)[i]) continue;
+            cellNodes[cursor[cellOf[i]]++] = static_cast<NodeId>(i);
+        }
+    }
+
+    bool empty() const { return cellNodes.empty(); }
+
+    void saveSnapshot(SnapshotWriter& writer) const {
+        GridParams params;
+        std::memset(&params, 0, sizeof(params));
+        params.minLat = minLat;
+        params.minLon = minLon;
+        params.cellLat = cellLat;
+        params.cellLon = cellLon;
+        params.maxAbsLat = maxAbsLat;
+        params.rows = rows;
+        params.cols = cols;
+        writer.addValue("spatial.params", params);
+        writer.addArray("spatial.cellOffsets", cellOffsets);
+        writer.addArray("spatial.cellNodes", cellNodes);
+        writer.addArray("spatial.latRad", latRad);
+        writer.addArray("spatial.lonRad", lonRad);
+        writer.addArray("spatial.cosLat", cosLat);
+    }
+
+    bool loadSnapshot(const SnapshotReader& reader) {
+        GridParams params;
+        if (!reader.getValue("spatial.params", params) ||
+            !reader.getArray("spatial.cellOffsets", cellOffsets) ||
+            !reader.getArray("spatial.cellNodes", cellNodes) ||
+            !reader.getArray("spatial.latRad", latRad) ||
+            !reader.getArray("spatial.lonRad", lonRad) ||
+            !reader.getArray("spatial.cosLat", cosLat)) return false;
+        minLat = params.minLat;
+        minLon = params.minLon;
+        cellLat = params.cellLat;
+        cellLon = params.cellLon;
+        maxAbsLat = params.maxAbsLat;
+        rows = params.rows;
+        cols = params.cols;
+        return true;
+    }
+
+    // Every node's coordinates, indexed by node ID, for GeoKernels
+    GeoPoints points() const { return GeoPoints(latRad.data(), lonRad.data(), cosLat.data()); }
+    size_t size() const { return latRad.size(); }
+
+    double distanceBetween(NodeId a, NodeId b) const {
+        return haversineRadians(latRad[a], lonRad[a], cosLat[a], latRad[b], lonRad[b], cosLat[b]);
+    }
+
+    // The k nearest nodes, closest first
+    std::vector<NodeId> nearestK(const Location& target, size_t k) const {
+        std::vector<NodeId> result;
+        if (empty() || k == 0) return result;
+
+        std::vector<Candidate> heap;
+        heap.reserve(k);
+        KNearestVisitor visit(*this, target, k, heap);
+
+        QueryCell q = locate(target);
+        for (int ring = 0; ring <= q.lastRing; ring++) {
+            if (heap.size() == k &&
+                heap.front().dist < ringLowerBound(ring, target.lat, q.rowFrac, q.colFrac)) break;
+            visitRing(q.row, q.col, ring, visit);
+        }
+
+        std::sort_heap(heap.begin(), heap.end());
+        for (size_t i = 0; i < heap.size(); i++) {
+            result.push_back(heap[i].node);
+        }
+        return result;
+    }
+
+    NodeId nearest(const Location& target) const {
+        if (empty()) return INVALID_NODE;
+
+        NearestVisitor visit(*this, target);
+        QueryCell q = locate(target);
+        for (int ring = 0; ring <= q.lastRing; ring++) {
+            if (visit.best != INVALID_NODE &&
+                haversineFromTerm(visit.bestTerm) < ringLowerBound(ring, target.lat, q.rowFrac, q.colFrac)) break;
+            visitRing(q.row, q.col, ring, visit);
+        }
+        return visit.best;
+    }
+
+    // All nodes within radiusKm, closest first
+    std::vector<NodeId> withinRadius(const Location& target, double radiusKm) const {
+        std::vector<NodeId> result;
+        if (empty()) return result;
+
+        std::vector<Candidate> found;
+        RadiusVisitor visit(*this, target, radiusKm, found);
+
+        QueryCell q = locate(target);
+        for (int ring = 0; ring <= q.lastRing; ring++) {
+            if (radiusKm < ringLowerBound(ring, target.lat, q.rowFrac, q.colFrac)) break;
+            visitRing(q.row, q.col, ring, visit);
+        }
+
+        std::sort(found.begin(), found.end());
+        for (size_t i = 0; i < found.size(); i++) {
+            result.push_back(found[i].node);
+        }
+        return result;
+    }
+
+    // Snaps many points in one pass. Queries are processed in cell order so
+    // neighbouring points reuse the same cells while they are hot; results
+    // are written in input order.
+    void nearestBatch(const std::vector<Location>& targets, std::vector<NodeId>& result) const {
+        result.assign(targets.size(), INVALID_NODE);
+        if (empty()) return;
+
+        std::vector<std::pair<long long, size_t>> order;
+        order.reserve(targets.size());
+        for (size_t i = 0; i < targets.size(); i++) {
+            long long cell = static_cast<long long>(rowOf(targets[i].lat)) * cols + colOf(targets[i].lon);
+            order.push_back(std::make_pair(cell, i));
+        }
+        std::sort(order.begin(), order.end());
+
+        for (size_t i = 0; i < order.size(); i++) {
+            size_t q = order[i].second;
+            result[q] = nearest(targets[q]);
+        }
+    }
+};
+
+#endif // SPATIAL_INDEX_H
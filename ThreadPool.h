@@ -0,0 +1,149 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+// Fixed set of worker threads, each with its own task deque. A worker pops
+// from the back of its own deque and, when that is empty, steals from the
+// front of the others', so uneven tasks (long and short routes) still keep
+// every core busy. Tasks receive the index of the worker running them,
+// which callers use to pick per-worker state such as a solver.
+class ThreadPool {
+public:
+    typedef std::function<void(size_t)> Task;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    bool stopping;
+
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::atomic<size_t> unfinished;
+    std::atomic<size_t> nextQueue;
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    bool popOwn(size_t worker, Task& task) {
+        WorkerQueue& q = *queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t worker, Task& task) {
+        for (size_t i = 1; i < queues.size(); i++) {
+            WorkerQueue& q = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t worker) {
+        Task task;
+        while (true) {
+            if (popOwn(worker, task) || steal(worker, task)) {
+                queued--;
+                task(worker);
+                task = Task();
+                if (--unfinished == 0) {
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    done.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) return;
+        }
+    }
+
+public:
+    // threadCount 0 means one per hardware thread
+    explicit ThreadPool(size_t threadCount = 0)
+        : queued(0), stopping(false), unfinished(0), nextQueue(0) {
+        if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threadCount; i++) {
+            queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.push_back(std::thread(&ThreadPool::run, this, i));
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+
+    size_t size() const { return threads.size(); }
+
+    // Queues a task; tasks are dealt round-robin and rebalanced by stealing
+    void submit(const Task& task) {
+        unfinished++;
+        {
+            // Counted before it is visible so the count never underflows;
+            // under sleepMutex so a worker about to sleep cannot miss it
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued++;
+        }
+        WorkerQueue& q = *queues[nextQueue++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(task);
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait(lock, [this] { return unfinished == 0; });
+    }
+
+    // Runs body(i, worker) for every i in [0, count), in blocks of `grain`
+    // indices, and returns when all are done
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+        grain = std::max<size_t>(1, grain);
+        for (size_t begin = 0; begin < count; begin += grain) {
+            size_t end = std::min(count, begin + grain);
+            submit([begin, end, &body](size_t worker) {
+                for (size_t i = begin; i < end; i++) body(i, worker);
+            });
+        }
+        wait();
+    }
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,333 @@
+#ifndef TIME_DEPENDENT_ROUTER_H
+#define TIME_DEPENDENT_ROUTER_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "SearchWorkspace.h"
+#include "CostModels.h"
+#include "TimeModels.h"
+
+// A route found by TimeDependentRouter: the graph edges taken, when each one
+// is boarded (after any wait) and left, and the total fare.
+struct TimedPath {
+    std::vector<Edge> edges;
+    std::vector<double> departTimes;
+    std::vector<double> arriveTimes;
+    double cost;
+    bool found;
+
+    TimedPath() : cost(0.0), found(false) {}
+};
+
+// Searches over (node, arrival mode) states, since whether a traveller has
+// to wait for a departure depends on whether they are already aboard that
+// mode. Every search keeps its labels in a pool (one label per queued
+// state) whose parent links give the path back.
+//
+//   cheapest:  lexicographic (fare, arrival time)
+//   fastest:   lexicographic (arrival time, fare)
+//   deadline:  cheapest fare arriving by a deadline; bi-criteria label
+//              setting, where a label survives only if it arrives earlier
+//              than every cheaper label already settled at its state
+//
+// Edge functions are FIFO (TravelTimeModel::nextDeparture is monotone), so
+// all three are exact. Like AllProblemsSolver, one router per thread.
+class TimeDependentRouter {
+private:
+    struct Label {
+        double cost;
+        double time;
+        uint32_t parent;
+        uint32_t edge;
+        NodeId node;
+        TransportMode mode;
+    };
+
+    struct QueueEntry {
+        double primary;
+        double secondary;
+        uint32_t label;
+
+        bool operator>(const QueueEntry& other) const {
+            if (primary != other.primary) return primary > other.primary;
+            return secondary > other.secondary;
+        }
+    };
+
+    static const uint32_t NO_LABEL = 0xFFFFFFFFu;
+    // Slack for deadline checks, so a path summed in a different order
+    // than its lower bound is not pruned by rounding
+    static constexpr double DEADLINE_SLACK = 1e-9;
+
+    const DhakaGraph& graph;
+    TravelTimeModel model;
+
+    std::vector<Label> pool;
+    std::vector<QueueEntry> queue;
+
+    // Per-state bookkeeping, valid where stamp == generation
+    std::vector<uint32_t> stamp;
+    std::vector<double> bestPrimary;
+    std::vector<double> bestSecondary;
+    std::vector<uint8_t> settled;
+    uint32_t generation;
+
+    // Static (no waiting) travel time to the destination, for deadline pruning
+    SearchWorkspace remaining;
+    size_t settledLabels;
+
+    // Live traffic weights pinned by the caller (null for free flow)
+    const double* liveWeights;
+
+    // Length an edge takes to travel: slowed edges take longer at the
+    // mode's speed, and closed ones are infinite. Fares use the true length.
+    double travelKm(uint32_t e) const {
+        return liveWeights != nullptr ? liveWeights[e] : graph.edgeWeight(e);
+    }
+
+    static size_t stateOf(NodeId node, TransportMode mode) {
+        return static_cast<size_t>(node) * MODE_COUNT + static_cast<size_t>(mode);
+    }
+
+    void resetStates() {
+        size_t states = graph.getLocationCount() * MODE_COUNT;
+        if (stamp.size() != states) {
+            stamp.assign(states, 0);
+            bestPrimary.resize(states);
+            bestSecondary.resize(states);
+            settled.resize(states);
+            generation = 0;
+        }
+        if (++generation == 0) {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+        pool.clear();
+        queue.clear();
+        settledLabels = 0;
+    }
+
+    void touch(size_t state) {
+        if (stamp[state] == generation) return;
+        stamp[state] = generation;
+        bestPrimary[state] = std::numeric_limits<double>::infinity();
+        bestSecondary[state] = std::numeric_limits<double>::infinity();
+        settled[state] = 0;
+    }
+
+    void enqueue(const Label& label, double primary, double secondary) {
+        pool.push_back(label);
+        QueueEntry entry;
+        entry.primary = primary;
+        entry.secondary = secondary;
+        entry.label = static_cast<uint32_t>(pool.size() - 1);
+        queue.push_back(entry);
+        std::push_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+    }
+
+    uint32_t dequeue() {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<QueueEntry>());
+        uint32_t label = queue.back().label;
+        queue.pop_back();
+        return label;
+    }
+
+    // Calls visit(next) for every label reachable over one allowed edge.
+    // Boarding a scheduled mode waits for its next departure; staying on
+    // the mode just arrived by does not.
+    template <typename CostModel, typename Visitor>
+    void expand(uint32_t labelId, Visitor& visit) const {
+        const Label current = pool[labelId];
+        for (uint32_t e = graph.edgeBegin(current.node); e < graph.edgeEnd(current.node); e++) {
+            TransportMode mode = graph.edgeMode(e);
+            if (!modeAllowed(CostModel::allowedModes, mode)) continue;
+
+            double travel = travelKm(e);
+            if (std::isinf(travel)) continue;
+            double departure = (mode == current.mode) ? current.time : model.nextDeparture(mode, current.time);
+
+            Label next;
+            next.cost = current.cost + CostModel::cost(graph.edgeWeight(e), mode);
+            next.time = departure + model.travelMinutes(travel, mode);
+            next.parent = labelId;
+            next.edge = e;
+            next.node = graph.edgeTarget(e);
+            next.mode = mode;
+            visit(next);
+        }
+    }
+
+    Label startLabel(NodeId source, double startTime) const {
+        Label label;
+        label.cost = 0.0;
+        label.time = startTime;
+        label.parent = NO_LABEL;
+        label.edge = 0;
+        label.node = source;
+        label.mode = TransportMode::WALK;
+        return label;
+    }
+
+    TimedPath extract(uint32_t labelId) const {
+        TimedPath path;
+        path.found = true;
+        path.cost = pool[labelId].cost;
+        std::vector<uint32_t> ids;
+        for (uint32_t id = labelId; pool[id].parent != NO_LABEL; id = pool[id].parent) ids.push_back(id);
+        for (size_t i = ids.size(); i-- > 0;) {
+            const Label& label = pool[ids[i]];
+            const Label& prev = pool[label.parent];
+            size_t first = path.edges.size();
+            graph.appendEdge(prev.node, label.edge, path.edges);
+
+            // A chain edge's ride time is shared out by segment length
+            double depart = label.time - model.travelMinutes(travelKm(label.edge), label.mode);
+            double span = label.time - depart;
+            double length = graph.edgeWeight(label.edge);
+            for (size_t j = first; j < path.edges.size(); j++) {
+                double arrive = (j + 1 == path.edges.size() || length <= 0.0)
+                                    ? label.time
+                                    : depart + span * path.edges[j].distance / length;
+                path.departTimes.push_back(depart);
+                path.arriveTimes.push_back(arrive);
+                depart = arrive;
+            }
+        }
+        return path;
+    }
+
+    // Single-criterion (lexicographic) time-dependent Dijkstra
+    template <typename CostModel, bool TimeFirst>
+    struct LexicographicRelax {
+        TimeDependentRouter& router;
+
+        explicit LexicographicRelax(TimeDependentRouter& r) : router(r) {}
+
+        void operator()(const Label& next) {
+            size_t state = stateOf(next.node, next.mode);
+            router.touch(state);
+            if (router.settled[state]) return;
+
+            double primary = TimeFirst ? next.time : next.cost;
+            double secondary = TimeFirst ? next.cost : next.time;
+            if (primary > router.bestPrimary[state] ||
+                (primary == router.bestPrimary[state] && secondary >= router.bestSecondary[state])) return;
+            router.bestPrimary[state] = primary;
+            router.bestSecondary[state] = secondary;
+            router.enqueue(next, primary, secondary);
+        }
+    };
+
+    template <typename CostModel, bool TimeFirst>
+    TimedPath lexicographicSearch(NodeId source, NodeId destination, double startTime) {
+        resetStates();
+        if (source == INVALID_NODE || destination == INVALID_NODE) return TimedPath();
+
+        LexicographicRelax<CostModel, TimeFirst> relax(*this);
+        relax(startLabel(source, startTime));
+
+        while (!queue.empty()) {
+            uint32_t id = dequeue();
+            const Label& label = pool[id];
+            size_t state = stateOf(label.node, label.mode);
+            if (settled[state]) continue;
+            settled[state] = 1;
+            settledLabels++;
+
+            if (label.node == destination) return extract(id);
+            expand<CostModel>(id, relax);
+        }
+        return TimedPath();
+    }
+
+    // Backward static Dijkstra from the destination over travel minutes,
+    // stopped once no node could still make the deadline
+    template <typename CostModel>
+    void computeRemainingTimes(NodeId destination, double budget) {
+        remaining.reset(graph.getLocationCount());
+        remaining.setSource(destination);
+        while (!remaining.empty() && remaining.minKey() <= budget + DEADLINE_SLACK) {
+            NodeId current = remaining.settleNext();
+            double currentTime = remaining.distance(current);
+            for (uint32_t i = graph.inEdgeBegin(current); i < graph.inEdgeEnd(current); i++) {
+                uint32_t e = graph.inEdgeId(i);
+                TransportMode mode = graph.edgeMode(e);
+                if (!modeAllowed(CostModel::allowedModes, mode) || std::isinf(travelKm(e))) continue;
+                remaining.relax(graph.inEdgeSource(i), currentTime + model.travelMinutes(travelKm(e), mode),
+                                current, e);
+            }
+        }
+    }
+
+    // Bi-criteria relaxation: bestPrimary holds the earliest arrival among
+    // labels settled at the state, all of which are no more expensive
+    template <typename CostModel>
+    struct ParetoRelax {
+        TimeDependentRouter& router;
+        double deadline;
+
+        ParetoRelax(TimeDependentRouter& r, double d) : router(r), deadline(d) {}
+
+        void operator()(const Label& next) {
+            if (!router.remaining.isSettled(next.node) ||
+                next.time + router.remaining.distance(next.node) > deadline + DEADLINE_SLACK) return;
+            size_t state = stateOf(next.node, next.mode);
+            router.touch(state);
+            if (next.time >= router.bestPrimary[state]) return;
+            router.enqueue(next, next.cost, next.time);
+        }
+    };
+
+public:
+    TimeDependentRouter(const DhakaGraph& g, const TravelTimeModel& m = TravelTimeModel::dhakaDefault())
+        : graph(g), model(m), generation(0), settledLabels(0), liveWeights(nullptr) {}
+
+    const TravelTimeModel& getModel() const { return model; }
+    void setModel(const TravelTimeModel& m) { model = m; }
+
+    // Per-edge routing weights from a pinned TrafficSnapshot, or null for
+    // free flow; must outlive every search made while set
+    void setLiveWeights(const double* weights) { liveWeights = weights; }
+
+    // Labels settled by the most recent search
+    size_t getSettledCount() const { return settledLabels; }
+
+    template <typename CostModel>
+    TimedPath cheapest(NodeId source, NodeId destination, double startTime) {
+        return lexicographicSearch<CostModel, false>(source, destination, startTime);
+    }
+
+    template <typename CostModel>
+    TimedPath fastest(NodeId source, NodeId destination, double startTime) {
+        return lexicographicSearch<CostModel, true>(source, destination, startTime);
+    }
+
+    // Cheapest path reaching destination no later than deadline. Labels
+    // pop in (fare, time) order, so the first one at the destination is
+    // optimal; a static lower bound on the remaining time prunes labels
+    // that cannot make the deadline.
+    template <typename CostModel>
+    TimedPath cheapestWithinDeadline(NodeId source, NodeId destination, double startTime, double deadline) {
+        resetStates();
+        if (source == INVALID_NODE || destination == INVALID_NODE || deadline < startTime) return TimedPath();
+
+        computeRemainingTimes<CostModel>(destination, deadline - startTime);
+        ParetoRelax<CostModel> relax(*this, deadline);
+        relax(startLabel(source, startTime));
+
+        while (!queue.empty()) {
+            uint32_t id = dequeue();
+            const Label& label = pool[id];
+            size_t state = stateOf(label.node, label.mode);
+            if (label.time >= bestPrimary[state]) continue;
+            bestPrimary[state] = label.time;
+            settledLabels++;
+
+            if (label.node == destination) return extract(id);
+            expand<CostModel>(id, relax);
+        }
+        return TimedPath();
+    }
+};
+
+#endif // TIME_DEPENDENT_ROUTER_H
@@ -0,0 +1,108 @@
+#ifndef TIME_MODELS_H
+#define TIME_MODELS_H
+
+#include "DhakaRouting.h"
+
+// Times are minutes since midnight of the departure day; values past 1440
+// fall on the following day(s).
+const double MINUTES_PER_DAY = 24 * 60.0;
+
+const double CAR_SPEED_KMH = 20.0;
+const double METRO_SPEED_KMH = 30.0;
+const double BUS_SPEED_KMH = 15.0;
+
+// Departures every `headway` minutes from firstDeparture through
+// lastDeparture each day; a headway of 0 means available on demand.
+struct ModeSchedule {
+    double firstDeparture;
+    double lastDeparture;
+    double headway;
+
+    ModeSchedule() : firstDeparture(0.0), lastDeparture(MINUTES_PER_DAY), headway(0.0) {}
+    ModeSchedule(double first, double last, double every)
+        : firstDeparture(first), lastDeparture(last), headway(every) {}
+};
+
+// Per-mode speed and schedule. Vehicles are assumed to leave every node of
+// their line at the scheduled times, so boarding costs at most one headway.
+class TravelTimeModel {
+private:
+    double speedKmh[MODE_COUNT];
+    ModeSchedule schedules[MODE_COUNT];
+
+public:
+    TravelTimeModel() {
+        for (int m = 0; m < MODE_COUNT; m++) {
+            speedKmh[m] = WALK_SPEED_KMH;
+        }
+    }
+
+    // Walk and car on demand; metro every 10 minutes 07:00-22:00; both bus
+    // services every 15 minutes 06:00-23:00
+    static TravelTimeModel dhakaDefault() {
+        TravelTimeModel model;
+        model.setMode(TransportMode::WALK, WALK_SPEED_KMH, ModeSchedule());
+        model.setMode(TransportMode::CAR, CAR_SPEED_KMH, ModeSchedule());
+        model.setMode(TransportMode::METRO, METRO_SPEED_KMH, ModeSchedule(7 * 60.0, 22 * 60.0, 10.0));
+        model.setMode(TransportMode::BUS_BIKOLPO, BUS_SPEED_KMH, ModeSchedule(6 * 60.0, 23 * 60.0, 15.0));
+        model.setMode(TransportMode::BUS_UTTARA, BUS_SPEED_KMH, ModeSchedule(6 * 60.0, 23 * 60.0, 15.0));
+        return model;
+    }
+
+    void setMode(TransportMode mode, double kmh, const ModeSchedule& schedule) {
+        speedKmh[static_cast<int>(mode)] = kmh;
+        schedules[static_cast<int>(mode)] = schedule;
+    }
+
+    double getSpeed(TransportMode mode) const { return speedKmh[static_cast<int>(mode)]; }
+    const ModeSchedule& getSchedule(TransportMode mode) const { return schedules[static_cast<int>(mode)]; }
+
+    double travelMinutes(double distanceKm, TransportMode mode) const {
+        return distanceKm / speedKmh[static_cast<int>(mode)] * 60.0;
+    }
+
+    // Earliest departure of this mode at or after time t. Non-decreasing in
+    // t, which keeps every time-dependent edge FIFO.
+    double nextDeparture(TransportMode mode, double t) const {
+        const ModeSchedule& s = schedules[static_cast<int>(mode)];
+        if (s.headway <= 0.0) return t;
+
+        double day = std::floor(t / MINUTES_PER_DAY) * MINUTES_PER_DAY;
+        double local = t - day;
+        if (local <= s.firstDeparture) return day + s.firstDeparture;
+
+        double departure = s.firstDeparture + std::ceil((local - s.firstDeparture) / s.headway) * s.headway;
+        if (departure > s.lastDeparture) return day + MINUTES_PER_DAY + s.firstDeparture;
+        return day + departure;
+    }
+};
+
+// "HH:MM", with a " (+Nd)" suffix for later days
+inline std::string formatClock(double minutes) {
+    long total = static_cast<long>(std::floor(minutes + 0.5));
+    long days = total / static_cast<long>(MINUTES_PER_DAY);
+    long inDay = total % static_cast<long>(MINUTES_PER_DAY);
+    std::ostringstream oss;
+    oss << std::setw(2) << std::setfill('0') << inDay / 60 << ":"
+        << std::setw(2) << std::setfill('0') << inDay % 60;
+    if (days > 0) oss << " (+" << days << "d)";
+    return oss.str();
+}
+
+// Accepts "HH:MM" or a plain number of minutes since midnight
+inline bool parseClock(const std::string& text, double& minutes) {
+    std::istringstream in(text);
+    double hours;
+    if (!(in >> hours)) return false;
+    char colon;
+    if (!(in >> colon)) {
+        minutes = hours;
+        return true;
+    }
+    double mins;
+    if (colon != ':' || !(in >> mins)) return false;
+    minutes = hours * 60.0 + mins;
+    return true;
+}
+
+#endif // TIME_MODELS_H
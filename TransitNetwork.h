@@ -0,0 +1,359 @@
+#ifndef TRANSIT_NETWORK_H
+#define TRANSIT_NETWORK_H
+
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "MappedFile.h"
+#include "GeoKernels.h"
+
+// The metro and bus routemaps as explicit lines, for RaptorRouter. Each
+// routemap row is a polyline between two named stops; rows sharing an end
+// stop (or ending within LINE_JOIN_KM of one, to bridge digitizing gaps)
+// chain into lines. Every line runs in both directions, so it becomes two
+// routes: stop sequences with cumulative ride distance, plus the polyline
+// nodes of each hop for rebuilding full geometry. Stops are graph nodes
+// shared by every line that touches them; stops within TRANSFER_RADIUS_KM
+// that share no line are joined by footpaths. All arrays are flat and
+// indexed by route or stop ID, so a RAPTOR round is a few linear scans.
+class TransitNetwork {
+public:
+    static constexpr double LINE_JOIN_KM = 0.2;
+
+    struct Route {
+        TransportMode mode;
+        uint32_t firstStop;  // into routeStops and routeKm
+        uint32_t stopCount;
+        uint32_t firstHop;   // hop i joins positions i and i + 1 (see hopNodes)
+        bool reversed;       // hops are walked backwards
+    };
+
+    struct StopRoute {
+        uint32_t route;
+        uint32_t position;
+    };
+
+private:
+    const DhakaGraph* graph;
+    std::vector<Route> routes;
+    std::vector<uint32_t> routeStops;
+    std::vector<double> routeKm;
+
+    // Polyline nodes of each hop, for the forward route of its line
+    std::vector<uint32_t> hopOffsets;
+    std::vector<NodeId> hopNodes;
+
+    std::vector<NodeId> stopNodes;
+    std::vector<double> stopLat, stopLon, stopCosLat;  // radians, for GeoKernels
+    std::unordered_map<NodeId, uint32_t> stopOfNode;
+    std::vector<uint32_t> stopRouteOffsets;
+    std::vector<StopRoute> stopRoutes;
+    std::vector<uint32_t> footpathOffsets;
+    std::vector<uint32_t> footpathTargets;
+    std::vector<double> footpathKm;
+    size_t lineCount;
+
+    struct Segment {
+        uint32_t from;  // cluster IDs of the two end stops
+        uint32_t to;
+        std::vector<NodeId> nodes;
+        bool used;
+    };
+
+    uint32_t stopFor(NodeId node) {
+        auto it = stopOfNode.find(node);
+        if (it != stopOfNode.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(stopNodes.size());
+        stopNodes.push_back(node);
+        stopOfNode[node] = id;
+        return id;
+    }
+
+    double nodeDistance(NodeId a, NodeId b) const {
+        return haversineDistance(graph->getLocation(a), graph->getLocation(b));
+    }
+
+    // Appends nodes[from..to] in travel order to the current hop, forcing it
+    // to start and end on the given stop nodes
+    void appendHop(const std::vector<NodeId>& nodes, bool backwards, NodeId startStop, NodeId endStop) {
+        size_t begin = hopNodes.size();
+        hopNodes.push_back(startStop);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            NodeId node = backwards ? nodes[nodes.size() - 1 - i] : nodes[i];
+            if (node != hopNodes.back()) hopNodes.push_back(node);
+        }
+        if (hopNodes.back() != endStop || hopNodes.size() - begin < 2) hopNodes.push_back(endStop);
+        hopOffsets.push_back(static_cast<uint32_t>(hopNodes.size()));
+    }
+
+    double hopKm(uint32_t hop, TransportMode mode) const {
+        double km = 0.0;
+        for (uint32_t i = hopOffsets[hop]; i + 1 < hopOffsets[hop + 1]; i++) {
+            km += legKm(hopNodes[i], hopNodes[i + 1], mode);
+        }
+        return km;
+    }
+
+    // Chains one routemap's segments into lines: walks start at clusters
+    // whose degree is not 2, then any leftover loops
+    void addLines(std::vector<Segment>& segments, const std::vector<NodeId>& clusterNodes, TransportMode mode) {
+        size_t clusters = clusterNodes.size();
+        std::vector<std::vector<uint32_t>> incident(clusters);
+        for (uint32_t s = 0; s < segments.size(); s++) {
+            incident[segments[s].from].push_back(s);
+            incident[segments[s].to].push_back(s);
+        }
+
+        std::vector<uint32_t> starts;
+        for (uint32_t c = 0; c < clusters; c++) {
+            if (incident[c].size() != 2) starts.push_back(c);
+        }
+        for (uint32_t c = 0; c < clusters; c++) {
+            if (incident[c].size() == 2) starts.push_back(c);
+        }
+
+        for (size_t i = 0; i < starts.size(); i++) {
+            uint32_t current = starts[i];
+            while (true) {
+                uint32_t next = NO_SEGMENT;
+                for (size_t j = 0; j < incident[current].size(); j++) {
+                    if (!segments[incident[current][j]].used) {
+                        next = incident[current][j];
+                        break;
+                    }
+                }
+                if (next == NO_SEGMENT) break;
+
+                // One forward route per chain; its reverse is added below
+                Route route;
+                route.mode = mode;
+                route.firstStop = static_cast<uint32_t>(routeStops.size());
+                route.firstHop = static_cast<uint32_t>(hopOffsets.size() - 1);
+                route.reversed = false;
+                routeStops.push_back(stopFor(clusterNodes[current]));
+                routeKm.push_back(0.0);
+
+                while (next != NO_SEGMENT) {
+                    Segment& segment = segments[next];
+                    segment.used = true;
+                    bool backwards = segment.from != current;
+                    uint32_t other = backwards ? segment.from : segment.to;
+                    appendHop(segment.nodes, backwards, clusterNodes[current], clusterNodes[other]);
+                    routeStops.push_back(stopFor(clusterNodes[other]));
+                    routeKm.push_back(routeKm.back() + hopKm(static_cast<uint32_t>(hopOffsets.size() - 2), mode));
+                    current = other;
+
+                    next = NO_SEGMENT;
+                    if (incident[current].size() != 2) break;
+                    for (size_t j = 0; j < incident[current].size(); j++) {
+                        if (!segments[incident[current][j]].used) next = incident[current][j];
+                    }
+                }
+
+                route.stopCount = static_cast<uint32_t>(routeStops.size() - route.firstStop);
+                routes.push_back(route);
+                lineCount++;
+
+                Route reverse = route;
+                reverse.firstStop = static_cast<uint32_t>(routeStops.size());
+                reverse.reversed = true;
+                double total = routeKm.back();
+                for (uint32_t p = route.stopCount; p-- > 0;) {
+                    routeStops.push_back(routeStops[route.firstStop + p]);
+                    routeKm.push_back(total - routeKm[route.firstStop + p]);
+                }
+                routes.push_back(reverse);
+            }
+        }
+    }
+
+    void indexStops() {
+        size_t n = stopNodes.size();
+        stopRouteOffsets.assign(n + 1, 0);
+        for (uint32_t r = 0; r < routes.size(); r++) {
+            for (uint32_t p = 0; p < routes[r].stopCount; p++) stopRouteOffsets[routeStops[routes[r].firstStop + p] + 1]++;
+        }
+        for (size_t s = 0; s < n; s++) stopRouteOffsets[s + 1] += stopRouteOffsets[s];
+        stopRoutes.resize(stopRouteOffsets[n]);
+        std::vector<uint32_t> cursor(stopRouteOffsets.begin(), stopRouteOffsets.end() - 1);
+        for (uint32_t r = 0; r < routes.size(); r++) {
+            for (uint32_t p = 0; p < routes[r].stopCount; p++) {
+                StopRoute entry;
+                entry.route = r;
+                entry.position = p;
+                stopRoutes[cursor[routeStops[routes[r].firstStop + p]]++] = entry;
+            }
+        }
+
+        stopLat.resize(n);
+        stopLon.resize(n);
+        stopCosLat.resize(n);
+        for (size_t s = 0; s < n; s++) {
+            Location loc = graph->getLocation(stopNodes[s]);
+            stopLat[s] = toRadians(loc.lat);
+            stopLon[s] = toRadians(loc.lon);
+            stopCosLat[s] = std::cos(stopLat[s]);
+        }
+
+        // A few hundred stops at most, so one batch scan per stop is enough
+        footpathOffsets.assign(1, 0);
+        footpathTargets.clear();
+        footpathKm.clear();
+        std::vector<double> km(n);
+        std::vector<uint8_t> servesS(routes.size(), 0);
+        auto sharesRoute = [&](uint32_t t) {
+            for (uint32_t j = stopRouteOffsets[t]; j < stopRouteOffsets[t + 1]; j++) {
+                if (servesS[stopRoutes[j].route]) return true;
+            }
+            return false;
+        };
+        for (uint32_t s = 0; s < n; s++) {
+            // Stops of one line are linked by riding it, not walking
+            for (uint32_t j = stopRouteOffsets[s]; j < stopRouteOffsets[s + 1]; j++) servesS[stopRoutes[j].route] = 1;
+            GeoKernels::distancesFrom(stopLat[s], stopLon[s], stopCosLat[s], getStopPoints(), n, km.data());
+            for (uint32_t t = 0; t < n; t++) {
+                if (t == s || km[t] > TRANSFER_RADIUS_KM || sharesRoute(t)) continue;
+                footpathTargets.push_back(t);
+                footpathKm.push_back(km[t]);
+            }
+            footpathOffsets.push_back(static_cast<uint32_t>(footpathTargets.size()));
+            for (uint32_t j = stopRouteOffsets[s]; j < stopRouteOffsets[s + 1]; j++) servesS[stopRoutes[j].route] = 0;
+        }
+    }
+
+    static const uint32_t NO_SEGMENT = 0xFFFFFFFFu;
+
+public:
+    TransitNetwork() : graph(nullptr), lineCount(0) {}
+
+    // Reads the three routemaps over a graph that already holds their
+    // nodes (built from the same CSVs, or a snapshot of it). A missing
+    // file just contributes no lines.
+    void build(const DhakaGraph& g, const std::string& metroFile, const std::string& bikolpoFile,
+               const std::string& uttaraFile) {
+        graph = &g;
+        routes.clear();
+        routeStops.clear();
+        routeKm.clear();
+        hopOffsets.assign(1, 0);
+        hopNodes.clear();
+        stopNodes.clear();
+        stopOfNode.clear();
+        lineCount = 0;
+
+        loadLines(metroFile, TransportMode::METRO);
+        loadLines(bikolpoFile, TransportMode::BUS_BIKOLPO);
+        loadLines(uttaraFile, TransportMode::BUS_UTTARA);
+        indexStops();
+    }
+
+    void loadLines(const std::string& filename, TransportMode mode) {
+        MappedFile file;
+        if (!file.open(filename)) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return;
+        }
+
+        std::vector<Segment> segments;
+        std::vector<NodeId> clusterNodes;
+        std::vector<CSVField> fields;
+        std::vector<Location> coords;
+        auto clusterOf = [&](NodeId node) {
+            for (uint32_t c = 0; c < clusterNodes.size(); c++) {
+                if (clusterNodes[c] == node || nodeDistance(clusterNodes[c], node) <= LINE_JOIN_KM) return c;
+            }
+            clusterNodes.push_back(node);
+            return static_cast<uint32_t>(clusterNodes.size() - 1);
+        };
+
+        const char* end = file.data() + file.size();
+        const char* line = file.data();
+        while (line < end) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+            if (lineEnd == nullptr) lineEnd = end;
+            const char* next = lineEnd + (lineEnd < end ? 1 : 0);
+            CSVParser::splitFields(line, lineEnd, fields);
+            line = next;
+            if (fields.size() < 4) continue;
+
+            coords.clear();
+            CSVParser::parseCoordinates(fields, coords);
+            Segment segment;
+            for (size_t i = 0; i < coords.size(); i++) {
+                NodeId node = graph->findNode(coords[i]);
+                if (node != INVALID_NODE && (segment.nodes.empty() || segment.nodes.back() != node)) {
+                    segment.nodes.push_back(node);
+                }
+            }
+            if (segment.nodes.size() < 2) continue;
+            segment.from = clusterOf(segment.nodes.front());
+            segment.to = clusterOf(segment.nodes.back());
+            segment.used = false;
+            if (segment.from != segment.to) segments.push_back(segment);
+        }
+        addLines(segments, clusterNodes, mode);
+    }
+
+    bool empty() const { return routes.empty(); }
+    size_t getLineCount() const { return lineCount; }
+    size_t getRouteCount() const { return routes.size(); }
+    size_t getStopCount() const { return stopNodes.size(); }
+    size_t getFootpathCount() const { return footpathTargets.size(); }
+    const DhakaGraph& getGraph() const { return *graph; }
+
+    const Route& getRoute(uint32_t r) const { return routes[r]; }
+    uint32_t stopAt(const Route& route, uint32_t position) const { return routeStops[route.firstStop + position]; }
+    // Ride distance from the start of the route to a position
+    double kmAt(const Route& route, uint32_t position) const { return routeKm[route.firstStop + position]; }
+
+    NodeId getStopNode(uint32_t stop) const { return stopNodes[stop]; }
+    Location getStopLocation(uint32_t stop) const { return graph->getLocation(stopNodes[stop]); }
+    GeoPoints getStopPoints() const { return GeoPoints(stopLat.data(), stopLon.data(), stopCosLat.data()); }
+    std::string getStopName(uint32_t stop) const { return graph->getStationName(stopNodes[stop]); }
+
+    uint32_t stopRoutesBegin(uint32_t stop) const { return stopRouteOffsets[stop]; }
+    uint32_t stopRoutesEnd(uint32_t stop) const { return stopRouteOffsets[stop + 1]; }
+    const StopRoute& getStopRoute(uint32_t i) const { return stopRoutes[i]; }
+
+    uint32_t footpathsBegin(uint32_t stop) const { return footpathOffsets[stop]; }
+    uint32_t footpathsEnd(uint32_t stop) const { return footpathOffsets[stop + 1]; }
+    uint32_t footpathTarget(uint32_t i) const { return footpathTargets[i]; }
+    double footpathDistance(uint32_t i) const { return footpathKm[i]; }
+
+    // Ride distance between consecutive polyline nodes: the weight of the
+    // graph edge (or folded chain segment) of that mode, so rides measure
+    // what Problems 1-6 price. A hop forced onto a joined stop has no edge
+    // for that last step, which is measured in a straight line.
+    double legKm(NodeId from, NodeId to, TransportMode mode) const {
+        std::vector<uint32_t> edges, segments;
+        graph->findEdgesThrough(from, to, edges, segments);
+        double km = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < edges.size(); i++) {
+            if (graph->edgeMode(edges[i]) != mode) continue;
+            km = std::min(km, segments[i] == DhakaGraph::WHOLE_EDGE ? graph->edgeWeight(edges[i])
+                                                                     : graph->shapeWeight(segments[i]));
+        }
+        return std::isinf(km) ? nodeDistance(from, to) : km;
+    }
+
+    // Polyline nodes ridden between two positions of a route, in order.
+    // Some stations were digitized a few metres off the track, so the
+    // routemap runs out to them and back; a ride passing through skips
+    // such spurs, as a search over the graph does.
+    void rideNodes(const Route& route, uint32_t from, uint32_t to, std::vector<NodeId>& nodes) const {
+        nodes.clear();
+        uint32_t lastPosition = route.stopCount - 1;
+        for (uint32_t p = from; p < to; p++) {
+            uint32_t hop = route.firstHop + (route.reversed ? lastPosition - p - 1 : p);
+            uint32_t begin = hopOffsets[hop], end = hopOffsets[hop + 1];
+            for (uint32_t i = 0; i < end - begin; i++) {
+                NodeId node = route.reversed ? hopNodes[end - 1 - i] : hopNodes[begin + i];
+                if (!nodes.empty() && nodes.back() == node) continue;
+                if (nodes.size() >= 2 && nodes[nodes.size() - 2] == node) nodes.pop_back();
+                else nodes.push_back(node);
+            }
+        }
+    }
+};
+
+#endif // TRANSIT_NETWORK_H
@@ -0,0 +1,350 @@
+#include "DhakaRouting.h"
+#include "DhakaGraph.h"
+#include "CSVParser.h"
+#include "ContractionHierarchy.h"
+#include "AllProblemsSolver.h"
+#include "BatchSolver.h"
+#include <chrono>
+#include <random>
+#include <thread>
+#include <sys/resource.h>
+
+// Benchmark suite for the routing engine, run by `make bench`. Every metric
+// goes into one flat JSON object ("name": number, units in the name), so a
+// run can be diffed against a saved baseline with --baseline. The OD set is
+// drawn from road nodes with a fixed seed, so runs on one machine compare
+// like for like.
+//
+//   --queries n      OD pairs per problem for the latency percentiles (200)
+//   --max-threads n  largest thread count for batch throughput (hardware)
+//   --output file    where to write the JSON (bench_results.json)
+//   --baseline file  a previous output to compare against
+
+const char* const DEFAULT_BENCH_OUTPUT = "bench_results.json";
+const uint32_t BENCH_SEED = 20240601;
+const size_t NEAREST_LOOKUPS = 200000;
+const size_t BATCH_QUERIES_PER_PROBLEM = 100;
+const size_t GEOMETRY_SWEEPS = 20;
+const size_t COVERAGE_ORIGINS = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Peak resident set size so far, in KB (Linux reports ru_maxrss in KB)
+long peakRSSKilobytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+// Metrics in insertion order
+class BenchReport {
+private:
+    std::vector<std::pair<std::string, double>> metrics;
+
+public:
+    void add(const std::string& name, double value) {
+        metrics.push_back(std::make_pair(name, value));
+        std::cout << "  " << std::left << std::setw(36) << name << std::right << std::fixed
+                  << std::setprecision(3) << value << std::endl;
+    }
+
+    const std::vector<std::pair<std::string, double>>& getMetrics() const { return metrics; }
+
+    bool writeJSON(const std::string& filename) const {
+        std::ofstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot create " << filename << std::endl;
+            return false;
+        }
+        file << "{\n";
+        for (size_t i = 0; i < metrics.size(); i++) {
+            file << "  \"" << metrics[i].first << "\": " << std::setprecision(6) << std::fixed
+                 << metrics[i].second << (i + 1 < metrics.size() ? ",\n" : "\n");
+        }
+        file << "}\n";
+        return file.good();
+    }
+
+    // Reads the flat object writeJSON produces
+    static bool readJSON(const std::string& filename, std::vector<std::pair<std::string, double>>& out) {
+        std::ifstream file(filename.c_str());
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t open = line.find('"');
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            size_t colon = close == std::string::npos ? close : line.find(':', close);
+            if (colon == std::string::npos) continue;
+            out.push_back(std::make_pair(line.substr(open + 1, close - open - 1),
+                                         std::atof(line.c_str() + colon + 1)));
+        }
+        return true;
+    }
+};
+
+// p in [0, 100], nearest-rank on a sorted copy
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+    return values[rank == 0 ? 0 : rank - 1];
+}
+
+// Locations of random nodes with a car edge, i.e. points of Roadmap-Dhaka.csv,
+// counting shape points folded into car chains
+std::vector<Location> sampleRoadLocations(const DhakaGraph& graph, size_t count, std::mt19937& rng) {
+    std::vector<NodeId> roadNodes;
+    for (NodeId u = 0; u < graph.getLocationCount(); u++) {
+        if (graph.isShapePoint(u)) {
+            if (graph.edgeMode(graph.getShapeEdge(u)) == TransportMode::CAR) roadNodes.push_back(u);
+            continue;
+        }
+        for (uint32_t e = graph.edgeBegin(u); e < graph.edgeEnd(u); e++) {
+            if (graph.edgeMode(e) == TransportMode::CAR) {
+                roadNodes.push_back(u);
+                break;
+            }
+        }
+    }
+    std::vector<Location> points;
+    if (roadNodes.empty()) return points;
+    std::uniform_int_distribution<size_t> pick(0, roadNodes.size() - 1);
+    for (size_t i = 0; i < count; i++) {
+        points.push_back(graph.getLocation(roadNodes[pick(rng)]));
+    }
+    return points;
+}
+
+std::vector<BatchQuery> makeQueries(const std::vector<Location>& points, int problem, size_t count) {
+    std::vector<BatchQuery> queries(count);
+    for (size_t i = 0; i < count; i++) {
+        queries[i].source = points[(2 * i) % points.size()];
+        queries[i].destination = points[(2 * i + 1) % points.size()];
+        queries[i].problem = problem;
+        queries[i].deadline = queries[i].departure + 60.0;
+    }
+    return queries;
+}
+
+void benchLoad(BenchReport& report, DhakaGraph& graph, ContractionHierarchy& carHierarchy) {
+    Clock::time_point start = Clock::now();
+    CSVParser::buildGraph(graph, "Roadmap-Dhaka.csv", "Routemap-DhakaMetroRail.csv",
+                          "Routemap-BikolpoBus.csv", "Routemap-UttaraBus.csv");
+    double loadMs = millisecondsSince(start);
+
+    start = Clock::now();
+    carHierarchy.build(graph, TransportMode::CAR);
+    double hierarchyMs = millisecondsSince(start);
+
+    std::cout << std::endl << "Load" << std::endl;
+    report.add("load.csv_ms", loadMs);
+    report.add("load.nodes", static_cast<double>(graph.getLocationCount()));
+    report.add("load.edges", static_cast<double>(graph.getEdgeCount()));
+    report.add("load.ch_build_ms", hierarchyMs);
+    report.add("load.peak_rss_kb", static_cast<double>(peakRSSKilobytes()));
+}
+
+// Random points over the network's bounding box, timed in one block since
+// a lookup is too short to time on its own
+void benchNearest(BenchReport& report, const DhakaGraph& graph, std::mt19937& rng) {
+    double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+    for (NodeId u = 0; u < graph.getLocationCount(); u++) {
+        Location loc = graph.getLocation(u);
+        minLat = std::min(minLat, loc.lat);
+        maxLat = std::max(maxLat, loc.lat);
+        minLon = std::min(minLon, loc.lon);
+        maxLon = std::max(maxLon, loc.lon);
+    }
+    std::uniform_real_distribution<double> lat(minLat, maxLat), lon(minLon, maxLon);
+    std::vector<Location> points;
+    points.reserve(NEAREST_LOOKUPS);
+    for (size_t i = 0; i < NEAREST_LOOKUPS; i++) points.push_back(Location(lat(rng), lon(rng)));
+
+    uint64_t checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < points.size(); i++) checksum += graph.findNearestNode(points[i]);
+    double ms = millisecondsSince(start);
+
+    std::cout << std::endl << "Nearest node (checksum " << checksum << ")" << std::endl;
+    report.add("nearest.mean_ns", ms * 1e6 / points.size());
+}
+
+// One-to-all distance sweeps over every node with each kernel level the
+// CPU supports, in both distance modes
+void benchGeometry(BenchReport& report, const DhakaGraph& graph, const std::vector<Location>& points) {
+    std::vector<double> distances;
+    std::cout << std::endl << "Batch distances (" << GEOMETRY_SWEEPS << " sweeps over every node)" << std::endl;
+    for (int level = GeoKernels::SCALAR; level <= GeoKernels::supportedLevel(); level++) {
+        GeoKernels::setLevel(static_cast<GeoKernels::Level>(level));
+        const char* name = GeoKernels::levelName(GeoKernels::activeLevel());
+        for (int mode = 0; mode < 2; mode++) {
+            double checksum = 0.0;
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < GEOMETRY_SWEEPS; i++) {
+                graph.distancesFrom(points[i % points.size()], distances,
+                                    mode == 0 ? DistanceMode::HAVERSINE : DistanceMode::EQUIRECTANGULAR);
+                checksum += distances[i % distances.size()];
+            }
+            double ms = millisecondsSince(start);
+            std::cout << "  " << name << (mode == 0 ? " haversine" : " equirectangular") << " (checksum "
+                      << std::fixed << std::setprecision(3) << checksum << ")" << std::endl;
+            report.add(std::string("geometry.") + (mode == 0 ? "haversine_" : "equirect_") + name + "_ns",
+                       ms * 1e6 / (GEOMETRY_SWEEPS * distances.size()));
+        }
+    }
+    GeoKernels::setLevel(GeoKernels::supportedLevel());
+}
+
+void benchProblems(BenchReport& report, const DhakaGraph& graph, const ContractionHierarchy& carHierarchy,
+                   const std::vector<Location>& points, size_t queryCount) {
+    AllProblemsSolver solver(graph);
+    solver.setCarHierarchy(&carHierarchy);
+    CompactRoute route;
+
+    std::cout << std::endl << "Query latency (" << queryCount << " OD pairs per problem, microseconds)"
+              << std::endl;
+    for (int problem = 1; problem <= 6; problem++) {
+        std::vector<BatchQuery> queries = makeQueries(points, problem, queryCount);
+        std::vector<double> micros;
+        micros.reserve(queries.size());
+        size_t found = 0;
+        for (size_t i = 0; i < queries.size(); i++) {
+            Clock::time_point start = Clock::now();
+            solver.solveRoute(problem, queries[i].source, queries[i].destination, route,
+                              queries[i].departure, queries[i].deadline);
+            micros.push_back(millisecondsSince(start) * 1000.0);
+            if (route.found()) found++;
+        }
+
+        double total = 0.0;
+        for (size_t i = 0; i < micros.size(); i++) total += micros[i];
+        std::string prefix = "problem" + std::to_string(problem) + ".";
+        report.add(prefix + "mean_us", micros.empty() ? 0.0 : total / micros.size());
+        report.add(prefix + "p50_us", percentile(micros, 50));
+        report.add(prefix + "p90_us", percentile(micros, 90));
+        report.add(prefix + "p99_us", percentile(micros, 99));
+        report.add(prefix + "found", static_cast<double>(found));
+    }
+}
+
+// Mixed Problem 1-6 workload, uncached, at 1, 2, 4, ... threads
+void benchBatch(BenchReport& report, const DhakaGraph& graph, const ContractionHierarchy& carHierarchy,
+                const std::vector<Location>& points, size_t maxThreads) {
+    std::vector<BatchQuery> queries;
+    for (int problem = 1; problem <= 6; problem++) {
+        std::vector<BatchQuery> part = makeQueries(points, problem, BATCH_QUERIES_PER_PROBLEM);
+        queries.insert(queries.end(), part.begin(), part.end());
+    }
+
+    std::cout << std::endl << "Batch throughput (" << queries.size() << " mixed queries)" << std::endl;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        BatchSolver batch(graph, threads, &carHierarchy);
+        Clock::time_point start = Clock::now();
+        std::vector<CompactRoute> results = batch.solveBatch(queries);
+        double seconds = millisecondsSince(start) / 1000.0;
+        report.add("batch.threads" + std::to_string(threads) + "_qps", seconds > 0 ? results.size() / seconds : 0.0);
+    }
+}
+
+// Coverage of many depots: one bounded sweep per origin folded into a grid,
+// per problem, with a 5 km / Tk100 / Tk100 budget
+void benchCoverage(BenchReport& report, const DhakaGraph& graph, const std::vector<Location>& points,
+                   size_t maxThreads) {
+    std::vector<Location> origins(points.begin(), points.begin() + std::min(points.size(), COVERAGE_ORIGINS));
+    const double budgets[] = {5.0, 100.0, 100.0};
+
+    std::cout << std::endl << "Coverage (" << origins.size() << " origins, " << maxThreads << " threads)"
+              << std::endl;
+    BatchSolver batch(graph, maxThreads);
+    for (int problem = 1; problem <= 3; problem++) {
+        IsochroneGrid grid(graph);
+        std::vector<size_t> reached;
+        Clock::time_point start = Clock::now();
+        batch.solveCoverage(origins, problem, budgets[problem - 1], grid, reached);
+        double ms = millisecondsSince(start);
+        size_t total = 0;
+        for (size_t i = 0; i < reached.size(); i++) total += reached[i];
+        std::string prefix = "coverage.problem" + std::to_string(problem) + "_";
+        report.add(prefix + "ms", ms);
+        report.add(prefix + "nodes_per_origin", origins.empty() ? 0.0 : double(total) / origins.size());
+        report.add(prefix + "cells", static_cast<double>(grid.reachedCells()));
+    }
+}
+
+void compareWithBaseline(const BenchReport& report, const std::string& baselineFile) {
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!BenchReport::readJSON(baselineFile, baseline)) return;
+
+    std::cout << std::endl << "Against " << baselineFile << std::endl;
+    const std::vector<std::pair<std::string, double>>& current = report.getMetrics();
+    for (size_t i = 0; i < current.size(); i++) {
+        for (size_t j = 0; j < baseline.size(); j++) {
+            if (baseline[j].first != current[i].first) continue;
+            double before = baseline[j].second;
+            std::cout << "  " << std::left << std::setw(36) << current[i].first << std::right
+                      << std::setprecision(3) << std::setw(14) << before << " -> " << std::setw(14)
+                      << current[i].second;
+            if (before != 0.0) {
+                std::cout << "  (" << std::showpos << std::setprecision(1)
+                          << 100.0 * (current[i].second - before) / before << "%)" << std::noshowpos;
+            }
+            std::cout << std::endl;
+            break;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t queryCount = 200;
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::string output = DEFAULT_BENCH_OUTPUT, baselineFile;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--queries" && hasValue) {
+            queryCount = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--max-threads" && hasValue) {
+            maxThreads = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--output" && hasValue) {
+            output = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselineFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--queries n] [--max-threads n] [--output file]"
+                      << " [--baseline file]" << std::endl;
+            return 1;
+        }
+    }
+
+    BenchReport report;
+    DhakaGraph graph;
+    ContractionHierarchy carHierarchy;
+    benchLoad(report, graph, carHierarchy);
+    if (graph.getLocationCount() == 0) {
+        std::cerr << "Error: No graph loaded; run from the directory with the CSVs" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 rng(BENCH_SEED);
+    std::vector<Location> points = sampleRoadLocations(graph, 2 * std::max(queryCount, BATCH_QUERIES_PER_PROBLEM), rng);
+    benchNearest(report, graph, rng);
+    benchGeometry(report, graph, points);
+    benchProblems(report, graph, carHierarchy, points, queryCount);
+    benchBatch(report, graph, carHierarchy, points, maxThreads);
+    benchCoverage(report, graph, points, maxThreads);
+
+    std::cout << std::endl << "Memory" << std::endl;
+    report.add("memory.peak_rss_kb", static_cast<double>(peakRSSKilobytes()));
+
+    if (!report.writeJSON(output)) return 1;
+    std::cout << std::endl << "Results written to " << output << std::endl;
+    if (!baselineFile.empty()) compareWithBaseline(report, baselineFile);
+    return 0;
+}
@@ -1,94 +1,367 @@
 #include "DhakaRouting.h"
 #include "DhakaGraph.h"
 #include "CSVParser.h"
+#include "ContractionHierarchy.h"
+#include "LiveTraffic.h"
+#include "TransitNetwork.h"
 #include "AllProblemsSolver.h"
+#include "BatchSolver.h"
+#include "MatrixSolver.h"
+#include "RouteWriter.h"
+#ifdef __linux__
+#include "RoutingServer.h"
+#endif
+#include <chrono>
+
+const char* const DEFAULT_SNAPSHOT_FILE = "dhaka_graph.snap";
+const char* const DEFAULT_BATCH_OUTPUT = "batch_results.csv";
+const char* const DEFAULT_MATRIX_OUTPUT = "distance_matrix.csv";
+const char* const DEFAULT_COVERAGE_OUTPUT = "coverage.geojson";
 
 void printSeparator(char c = '=', int width = 80) {
     for (int i = 0; i < width; i++) std::cout << c;
     std::cout << std::endl;
 }
 
-void printResult(int problemNum, const RouteResult& result, 
-                const Location& source, const Location& dest, bool showCost) {
-    std::cout << "Problem " << problemNum << std::endl;
-    std::cout << "Source: " << source.toString() << std::endl;
-    std::cout << "Destination: " << dest.toString() << std::endl << std::endl;
-    
-    for (size_t i = 0; i < result.segments.size(); i++) {
-        std::cout << "Segment " << (i+1) << ": " 
-                  << transportModeToString(result.modes[i]) << " from ";
-        
-        if (!result.startNames[i].empty()) 
-            std::cout << result.startNames[i] << " ";
-        std::cout << result.segments[i].first.toString() << " to ";
-        
-        if (!result.endNames[i].empty()) 
-            std::cout << result.endNames[i] << " ";
-        std::cout << result.segments[i].second.toString() << std::endl;
-        
-        std::cout << "           Distance: " << std::fixed << std::setprecision(2) 
-                  << result.distances[i] << " km";
-        
-        if (showCost) {
-            std::cout << ", Cost: Tk" << std::fixed << std::setprecision(2) 
-                      << result.costs[i];
+void printResult(RouteWriter& writer, int problemNum, const CompactRoute& route, bool showCost) {
+    writer.appendText(problemNum, route, showCost);
+    writer.flush(std::cout);
+}
+
+// One line per frontier route: fare, distance and the sequence of modes
+void printRouteOptions(const std::vector<RouteResult>& options) {
+    for (size_t k = 0; k < options.size(); k++) {
+        const RouteResult& option = options[k];
+        double distance = 0.0;
+        for (size_t i = 0; i < option.distances.size(); i++) distance += option.distances[i];
+        
+        std::cout << "Option " << (k + 1) << ": Tk" << std::fixed << std::setprecision(2)
+                  << option.totalValue << ", " << distance << " km, ";
+        for (size_t i = 0; i < option.modes.size(); i++) {
+            if (i > 0) std::cout << " > ";
+            std::cout << transportModeToString(option.modes[i]);
         }
         std::cout << std::endl;
     }
-    
-    std::cout << std::endl;
-    if (showCost) {
-        std::cout << "Total Cost: Tk" << std::fixed << std::setprecision(2) 
-                  << result.totalValue << std::endl;
-    } else {
-        std::cout << "Total Distance: " << std::fixed << std::setprecision(2) 
-                  << result.totalValue << " km" << std::endl;
-    }
 }
 
-void generateKML(const RouteResult& result, const std::string& filename) {
-    std::ofstream file(filename.c_str());
-    if (!file.is_open()) return;
-    
-    file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
-    file << "<kml xmlns=\"http://earth.google.com/kml/2.1\">\n";
-    file << "<Document><Placemark><n>route</n>\n";
-    file << "<LineString><tessellate>1</tessellate>\n<coordinates>\n";
-    
-    for (size_t i = 0; i < result.segments.size(); i++) {
-        file << std::fixed << std::setprecision(6)
-             << result.segments[i].first.lon << "," 
-             << result.segments[i].first.lat << ",0\n";
-    }
-    
-    if (!result.segments.empty()) {
-        file << std::fixed << std::setprecision(6)
-             << result.segments.back().second.lon << "," 
-             << result.segments.back().second.lat << ",0\n";
+// One line per transit journey: arrival, trips, fare and the rides taken
+void printTransitOptions(const std::vector<RouteResult>& journeys) {
+    if (journeys.empty()) std::cout << "No transit journey found" << std::endl;
+    for (size_t k = 0; k < journeys.size(); k++) {
+        const RouteResult& journey = journeys[k];
+        double fare = 0.0;
+        size_t trips = 0;
+        for (size_t i = 0; i < journey.costs.size(); i++) fare += journey.costs[i];
+        for (size_t i = 0; i < journey.modes.size(); i++) trips += journey.modes[i] != TransportMode::WALK;
+        
+        std::cout << "Option " << (k + 1) << ": arrive " << formatClock(journey.arriveTimes.back()) << " ("
+                  << std::fixed << std::setprecision(1) << journey.totalValue << " min), " << trips
+                  << (trips == 1 ? " trip" : " trips") << ", Tk" << std::setprecision(2) << fare << ", ";
+        bool first = true;
+        for (size_t i = 0; i < journey.modes.size(); i++) {
+            if (journey.modes[i] == TransportMode::WALK) continue;
+            std::cout << (first ? "" : " > ") << transportModeToString(journey.modes[i]) << " "
+                      << journey.startNames[i] << " - " << journey.endNames[i];
+            first = false;
+        }
+        std::cout << std::endl;
     }
-    
-    file << "</coordinates></LineString></Placemark></Document></kml>\n";
-    file.close();
 }
 
-int main() {
+void printSearchStats(const SearchStats& stats) {
+    std::cout << "Settled nodes: " << stats.settledNodes << std::endl;
+}
+
+// Dumps every query and load phase recorded so far, if --stats was given
+bool writeStats(const std::string& filename) {
+    if (filename.empty()) return true;
+    if (!StatsRegistry::global().writeFile(filename)) return false;
+    std::cout << "  ✓ Search statistics written to " << filename << std::endl;
+    return true;
+}
+
+void generateKML(RouteWriter& writer, const CompactRoute& route, const std::string& filename) {
+    writer.beginKML(filename);
+    writer.appendKMLRoute(route, "route");
+    writer.endKML();
+    writer.writeFile(filename);
+}
+
+int main(int argc, char* argv[]) {
+    // --build-snapshot [file]: load the CSVs, build the hierarchy, save both
+    // --snapshot [file]: map a saved snapshot instead of parsing the CSVs
+    // --batch file [--output file] [--threads n] [--cache-mb n]: solve a file
+    //     of queries, reusing Problem 1-3 routes through an LRU cache (0 MB
+    //     disables it); CSV output, or JSON if the output ends in .json;
+    //     --geometry file also writes every route's full geometry as
+    //     GeoJSON, or KML if the file ends in .kml
+    // --matrix sources targets [--problem 1|2|3] [--output file] [--threads n]:
+    //     write an origin-destination matrix (binary if the output ends in .bin)
+    // --isochrone origins --budget x [--problem 1|2|3] [--cell-km x] [--output file]
+    //     [--threads n]: everything each origin reaches within x km (Problem 1)
+    //     or Tk (2, 3), merged into one coverage grid written as GeoJSON, or
+    //     KML if the output ends in .kml
+    // --serve unix:PATH | tcp:PORT [--snapshot file] [--threads n]: load the
+    //     graph once and answer requests until SIGINT or SIGTERM (see
+    //     RoutingServer); SIGHUP or a "reload" request reloads the graph
+    // --traffic file: replay a congestion feed (see LiveTraffic::readFeed)
+    //     before solving, batch by batch
+    // --stats file: write per-query search statistics and load timings on
+    //     exit, as Prometheus text if the file ends in .prom, else JSON
+    std::string buildSnapshotFile, snapshotFile, batchFile, matrixSources, matrixTargets, output, geometry;
+    std::string trafficFile, statsFile, isochroneOrigins, serveAddress;
+    size_t threads = 0;
+    size_t cacheMegabytes = RouteCache::DEFAULT_MAX_BYTES >> 20;
+    int problem = 1;
+    double budget = -1.0;
+    double cellKm = IsochroneGrid::DEFAULT_CELL_KM;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc && argv[i + 1][0] != '-');
+        if (arg == "--build-snapshot") {
+            buildSnapshotFile = hasValue ? argv[++i] : DEFAULT_SNAPSHOT_FILE;
+        } else if (arg == "--snapshot") {
+            snapshotFile = hasValue ? argv[++i] : DEFAULT_SNAPSHOT_FILE;
+        } else if (arg == "--batch" && hasValue) {
+            batchFile = argv[++i];
+        } else if (arg == "--matrix" && i + 2 < argc) {
+            matrixSources = argv[++i];
+            matrixTargets = argv[++i];
+        } else if (arg == "--isochrone" && hasValue) {
+            isochroneOrigins = argv[++i];
+        } else if (arg == "--serve" && hasValue) {
+            serveAddress = argv[++i];
+        } else if (arg == "--budget" && hasValue) {
+            budget = std::atof(argv[++i]);
+        } else if (arg == "--cell-km" && hasValue) {
+            cellKm = std::atof(argv[++i]);
+        } else if (arg == "--problem" && hasValue) {
+            problem = std::atoi(argv[++i]);
+        } else if (arg == "--geometry" && hasValue) {
+            geometry = argv[++i];
+        } else if (arg == "--output" && hasValue) {
+            output = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            threads = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--cache-mb" && hasValue) {
+            cacheMegabytes = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--traffic" && hasValue) {
+            trafficFile = argv[++i];
+        } else if (arg == "--stats" && hasValue) {
+            statsFile = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--build-snapshot [file] | --snapshot [file]]"
+                      << " [--batch file | --matrix sources targets [--problem 1|2|3]"
+                      << " | --isochrone origins --budget x [--problem 1|2|3] [--cell-km x]"
+                      << " | --serve unix:PATH|tcp:PORT]"
+                      << " [--output file] [--geometry file] [--threads n] [--cache-mb n] [--traffic file]"
+                      << " [--stats file]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
     printSeparator();
     std::cout << "  Dhaka Routing System - ALL 6 PROBLEMS" << std::endl;
     printSeparator();
     std::cout << std::endl;
     
-    // Load graph
-    std::cout << "Loading network..." << std::endl;
+    if (!serveAddress.empty()) {
+#ifdef __linux__
+        std::cout << "Loading " << (snapshotFile.empty() ? "network" : "snapshot " + snapshotFile) << "..."
+                  << std::endl;
+        std::shared_ptr<RoutingData> data = RoutingData::load(snapshotFile, 1);
+        if (!data) return 1;
+        std::cout << "Graph loaded: " << data->graph.getLocationCount() << " locations, "
+                  << data->graph.getEdgeCount() << " edges" << std::endl;
+        
+        RoutingServer server(data, snapshotFile, threads);
+        if (!server.listen(serveAddress)) return 1;
+        std::cout << "  ✓ Serving on " << serveAddress << " with " << server.getThreadCount() << " workers"
+                  << std::endl;
+        server.run();
+        std::cout << "  ✓ Server stopped" << std::endl;
+        return writeStats(statsFile) ? 0 : 1;
+#else
+        std::cerr << "Error: --serve is not supported on this platform" << std::endl;
+        return 1;
+#endif
+    }
+    
     DhakaGraph graph;
-    CSVParser::buildGraph(graph, "Roadmap-Dhaka.csv", "Routemap-DhakaMetroRail.csv",
-                         "Routemap-BikolpoBus.csv", "Routemap-UttaraBus.csv");
+    ContractionHierarchy carHierarchy;
+    if (!snapshotFile.empty()) {
+        std::cout << "Loading snapshot " << snapshotFile << "..." << std::endl;
+        SnapshotReader reader;
+        if (!reader.open(snapshotFile) || !graph.loadSnapshot(reader) ||
+            !carHierarchy.loadSnapshot(reader, graph)) {
+            return 1;
+        }
+        std::cout << "Graph loaded: " << graph.getLocationCount() << " locations, "
+                  << graph.getEdgeCount() << " edges" << std::endl;
+        std::cout << "  ✓ " << carHierarchy.getShortcutCount() << " car shortcuts" << std::endl;
+        printSeparator();
+        std::cout << std::endl;
+    } else {
+        // Load graph
+        std::cout << "Loading network..." << std::endl;
+        CSVParser::buildGraph(graph, "Roadmap-Dhaka.csv", "Routemap-DhakaMetroRail.csv",
+                             "Routemap-BikolpoBus.csv", "Routemap-UttaraBus.csv");
+        
+        std::cout << "Graph loaded: " << graph.getLocationCount() << " locations, "
+                  << graph.getEdgeCount() << " edges" << std::endl;
+        printSeparator();
+        std::cout << std::endl;
+        
+        std::cout << "Building car contraction hierarchy..." << std::endl;
+        carHierarchy.build(graph, TransportMode::CAR);
+        std::cout << "  ✓ " << carHierarchy.getShortcutCount() << " shortcuts added" << std::endl;
+        printSeparator();
+        std::cout << std::endl;
+    }
+
+    if (!buildSnapshotFile.empty()) {
+        SnapshotWriter writer;
+        graph.saveSnapshot(writer);
+        carHierarchy.saveSnapshot(writer);
+        if (!writer.write(buildSnapshotFile)) return 1;
+        std::cout << "Snapshot written to " << buildSnapshotFile << std::endl;
+        return 0;
+    }
+    
+    LiveTraffic traffic(graph, &carHierarchy);
+    if (!trafficFile.empty()) {
+        std::cout << "Replaying traffic feed " << trafficFile << "..." << std::endl;
+        std::vector<TrafficBatch> batches;
+        size_t unmatched = 0;
+        if (!traffic.readFeed(trafficFile, batches, unmatched)) return 1;
+        
+        auto start = std::chrono::steady_clock::now();
+        size_t updates = 0;
+        for (size_t i = 0; i < batches.size(); i++) {
+            traffic.apply(batches[i].updates);
+            updates += batches[i].updates.size();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        std::shared_ptr<const TrafficSnapshot> current = traffic.snapshot();
+        std::cout << "  ✓ " << batches.size() << " batches, " << updates << " edge updates ("
+                  << unmatched << " unmatched) in " << std::fixed << std::setprecision(2) << seconds
+                  << " s" << std::endl;
+        if (current) {
+            std::cout << "  ✓ Traffic version " << current->version << ": " << current->closedEdges
+                      << " edges closed, " << current->slowedEdges << " slowed" << std::endl;
+        }
+        printSeparator();
+        std::cout << std::endl;
+    }
+    
+    if (problem < 1 || problem > 3) {
+        std::cerr << "Error: --problem must be 1, 2 or 3" << std::endl;
+        return 1;
+    }
+    
+    if (!batchFile.empty()) {
+        std::string batchOutput = output.empty() ? DEFAULT_BATCH_OUTPUT : output;
+        std::vector<BatchQuery> queries;
+        if (!BatchSolver::readQueries(batchFile, queries)) return 1;
+        
+        BatchSolver batch(graph, threads, &carHierarchy);
+        batch.setLiveTraffic(&traffic);
+        RouteCache cache(cacheMegabytes << 20);
+        if (cacheMegabytes > 0) batch.setRouteCache(&cache);
+        std::cout << "Solving " << queries.size() << " queries on " << batch.getThreadCount()
+                  << " threads..." << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<CompactRoute> results = batch.solveBatch(queries);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        if (!BatchSolver::writeResults(batchOutput, graph, queries, results)) return 1;
+        std::cout << "  ✓ " << results.size() << " results written to " << batchOutput << " in "
+                  << std::fixed << std::setprecision(2) << seconds << " s ("
+                  << std::setprecision(0) << (seconds > 0 ? results.size() / seconds : 0.0)
+                  << " queries/s)" << std::endl;
+        if (!geometry.empty()) {
+            if (!BatchSolver::writeGeometry(geometry, graph, queries, results)) return 1;
+            std::cout << "  ✓ Route geometry written to " << geometry << std::endl;
+        }
+        if (cacheMegabytes > 0) {
+            RouteCacheStats stats = cache.getStats();
+            std::cout << "  ✓ Route cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                      << stats.evictions << " evictions, " << stats.entries << " routes in "
+                      << std::setprecision(1) << stats.bytes / 1024.0 << " KB" << std::endl;
+        }
+        return writeStats(statsFile) ? 0 : 1;
+    }
+    
+    if (!matrixSources.empty()) {
+        std::vector<Location> sources, targets;
+        if (!MatrixSolver::readPoints(matrixSources, sources) || !MatrixSolver::readPoints(matrixTargets, targets)) {
+            return 1;
+        }
+        std::string matrixOutput = output.empty() ? DEFAULT_MATRIX_OUTPUT : output;
+        
+        MatrixSolver matrixSolver(graph, threads, &carHierarchy);
+        matrixSolver.setLiveTraffic(&traffic);
+        std::cout << "Computing " << sources.size() << " x " << targets.size() << " Problem " << problem
+                  << " matrix on " << matrixSolver.getThreadCount() << " threads..." << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        DistanceMatrix matrix = matrixSolver.solve(sources, targets, problem);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        bool binary = matrixOutput.size() >= 4 && matrixOutput.compare(matrixOutput.size() - 4, 4, ".bin") == 0;
+        if (!(binary ? matrix.writeBinary(matrixOutput) : matrix.writeCSV(matrixOutput))) return 1;
+        std::cout << "  ✓ Matrix written to " << matrixOutput << " in " << std::fixed << std::setprecision(2)
+                  << seconds << " s" << std::endl;
+        return writeStats(statsFile) ? 0 : 1;
+    }
+    
+    if (!isochroneOrigins.empty()) {
+        std::vector<Location> origins;
+        if (!MatrixSolver::readPoints(isochroneOrigins, origins)) return 1;
+        if (!(budget >= 0.0) || !(cellKm > 0.0)) {
+            std::cerr << "Error: --isochrone needs a --budget of at least 0 and a positive --cell-km" << std::endl;
+            return 1;
+        }
+        std::string coverageOutput = output.empty() ? DEFAULT_COVERAGE_OUTPUT : output;
+        
+        BatchSolver batch(graph, threads, &carHierarchy);
+        batch.setLiveTraffic(&traffic);
+        std::cout << "Sweeping " << origins.size() << " Problem " << problem << " isochrones on "
+                  << batch.getThreadCount() << " threads..." << std::endl;
+        auto start = std::chrono::steady_clock::now();
+        IsochroneGrid grid(graph, cellKm);
+        std::vector<size_t> reached;
+        batch.solveCoverage(origins, problem, budget, grid, reached);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        size_t totalReached = 0;
+        for (size_t i = 0; i < reached.size(); i++) totalReached += reached[i];
+        if (!BatchSolver::writeCoverage(coverageOutput, graph, grid, budget)) return 1;
+        std::cout << "  ✓ " << std::fixed << std::setprecision(0)
+                  << (origins.empty() ? 0.0 : double(totalReached) / origins.size()) << " nodes per origin, "
+                  << grid.reachedCells() << " cells (" << std::setprecision(1)
+                  << grid.reachedCells() * cellKm * cellKm << " km²) covered in " << std::setprecision(2)
+                  << seconds << " s" << std::endl;
+        std::cout << "  ✓ Coverage grid written to " << coverageOutput << std::endl;
+        return writeStats(statsFile) ? 0 : 1;
+    }
     
-    std::cout << "Graph loaded: " << graph.getLocationCount() << " locations, "
-              << graph.getEdgeCount() << " edges" << std::endl;
+    std::cout << "Loading transit lines..." << std::endl;
+    TransitNetwork transit;
+    transit.build(graph, "Routemap-DhakaMetroRail.csv", "Routemap-BikolpoBus.csv", "Routemap-UttaraBus.csv");
+    std::cout << "  ✓ " << transit.getLineCount() << " lines, " << transit.getStopCount() << " stops, "
+              << transit.getFootpathCount() << " footpaths" << std::endl;
     printSeparator();
     std::cout << std::endl;
     
     AllProblemsSolver solver(graph);
+    solver.setCarHierarchy(&carHierarchy);
+    solver.setLiveTraffic(&traffic);
+    solver.setTransitNetwork(&transit);
+    RouteWriter writer(graph);
+    CompactRoute route;
     
 
     Location source1(23.834145, 90.363833);  
@@ -97,6 +370,10 @@ int main() {
     Location source2(23.810000, 90.370000);  
     Location dest2(23.750000, 90.395000);    
     
+    // Problems 4-6 leave at 08:00; Problem 6 must arrive by 08:27
+    const double departure = 8 * 60.0;
+    const double deadline = departure + 27.0;
+    
     std::vector<std::pair<Location, Location>> testCases;
     testCases.push_back(std::make_pair(source1, dest1));
     testCases.push_back(std::make_pair(source2, dest2));
@@ -111,62 +388,82 @@ int main() {
         // Problem 1
         std::cout << "\nPROBLEM 1: Shortest car route\n";
         printSeparator('-');
-        RouteResult r1 = solver.solveProblem1(src, dst);
-        printResult(1, r1, src, dst, false);
+        solver.solveRoute(1, src, dst, route);
+        printResult(writer, 1, route, false);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn1;
         fn1 << "problem1_case" << (tc+1) << ".kml";
-        generateKML(r1, fn1.str());
+        generateKML(writer, route, fn1.str());
         std::cout << "KML: " << fn1.str() << "\n" << std::endl;
         
         // Problem 2
         std::cout << "PROBLEM 2: Cheapest (Car+Metro)\n";
         printSeparator('-');
-        RouteResult r2 = solver.solveProblem2(src, dst);
-        printResult(2, r2, src, dst, true);
+        solver.solveRoute(2, src, dst, route);
+        printResult(writer, 2, route, true);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn2;
         fn2 << "problem2_case" << (tc+1) << ".kml";
-        generateKML(r2, fn2.str());
+        generateKML(writer, route, fn2.str());
         std::cout << "KML: " << fn2.str() << "\n" << std::endl;
         
         // Problem 3
         std::cout << "PROBLEM 3: Cheapest (All modes)\n";
         printSeparator('-');
-        RouteResult r3 = solver.solveProblem3(src, dst);
-        printResult(3, r3, src, dst, true);
+        solver.solveRoute(3, src, dst, route);
+        printResult(writer, 3, route, true);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn3;
         fn3 << "problem3_case" << (tc+1) << ".kml";
-        generateKML(r3, fn3.str());
+        generateKML(writer, route, fn3.str());
         std::cout << "KML: " << fn3.str() << "\n" << std::endl;
         
         // Problem 4
-        std::cout << "PROBLEM 4: Cheapest with time (simplified)\n";
+        std::cout << "PROBLEM 4: Cheapest with time (departing " << formatClock(departure) << ")\n";
         printSeparator('-');
-        RouteResult r4 = solver.solveProblem4(src, dst);
-        printResult(4, r4, src, dst, true);
+        solver.solveRoute(4, src, dst, route, departure);
+        printResult(writer, 4, route, true);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn4;
         fn4 << "problem4_case" << (tc+1) << ".kml";
-        generateKML(r4, fn4.str());
+        generateKML(writer, route, fn4.str());
         std::cout << "KML: " << fn4.str() << "\n" << std::endl;
         
         // Problem 5
-        std::cout << "PROBLEM 5: Fastest (simplified)\n";
+        std::cout << "PROBLEM 5: Fastest (departing " << formatClock(departure) << ")\n";
         printSeparator('-');
-        RouteResult r5 = solver.solveProblem5(src, dst);
-        printResult(5, r5, src, dst, true);
+        solver.solveRoute(5, src, dst, route, departure);
+        printResult(writer, 5, route, true);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn5;
         fn5 << "problem5_case" << (tc+1) << ".kml";
-        generateKML(r5, fn5.str());
+        generateKML(writer, route, fn5.str());
         std::cout << "KML: " << fn5.str() << "\n" << std::endl;
         
         // Problem 6
-        std::cout << "PROBLEM 6: Cheapest with deadline (simplified)\n";
+        std::cout << "PROBLEM 6: Cheapest with deadline (departing " << formatClock(departure)
+                  << ", arrive by " << formatClock(deadline) << ")\n";
         printSeparator('-');
-        RouteResult r6 = solver.solveProblem6(src, dst);
-        printResult(6, r6, src, dst, true);
+        solver.solveRoute(6, src, dst, route, departure, deadline);
+        printResult(writer, 6, route, true);
+        printSearchStats(solver.getLastSearchStats());
         std::ostringstream fn6;
         fn6 << "problem6_case" << (tc+1) << ".kml";
-        generateKML(r6, fn6.str());
+        generateKML(writer, route, fn6.str());
         std::cout << "KML: " << fn6.str() << "\n" << std::endl;
+        
+        // Trade-offs
+        std::cout << "ROUTE OPTIONS: Pareto frontier (fare, distance, mode switches)\n";
+        printSeparator('-');
+        printRouteOptions(solver.solveParetoFrontier(src, dst));
+        printSearchStats(solver.getLastSearchStats());
+        std::cout << std::endl;
+        
+        // Transit only, by number of trips
+        std::cout << "TRANSIT: Metro and bus lines (departing " << formatClock(departure) << ")\n";
+        printSeparator('-');
+        printTransitOptions(solver.solveTransit(src, dst, departure));
+        std::cout << std::endl;
     }
     
     printSeparator();
@@ -174,5 +471,5 @@ int main() {
     std::cout << "Generated 12 KML files (6 problems x 2 test cases)" << std::endl;
     printSeparator();
     
-    return 0;
+    return writeStats(statsFile) ? 0 : 1;
 }